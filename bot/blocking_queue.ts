@@ -1,10 +1,15 @@
 export class BlockingQueue<T> {
     private queue: T[];
     private pendingResolves: ((value: T | PromiseLike<T>) => void)[];
+    private compare?: (a: T, b: T) => number;
 
-    public constructor() {
+    /**
+     * @param compare Optional ordering; items that compare less are polled first, ties are kept in insertion order
+     */
+    public constructor(compare?: (a: T, b: T) => number) {
         this.queue = [];
         this.pendingResolves = [];
+        this.compare = compare;
     }
 
     /**
@@ -33,6 +38,10 @@ export class BlockingQueue<T> {
             // eslint-disable-next-line @typescript-eslint/no-non-null-assertion
             const resolve = this.pendingResolves.shift()!;
             resolve(item);
+        } else if (this.compare !== undefined) {
+            const compare = this.compare;
+            const index = this.queue.findIndex(entry => compare(item, entry) < 0);
+            this.queue.splice(index === -1 ? this.queue.length : index, 0, item);
         } else {
             this.queue.push(item);
         }
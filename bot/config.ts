@@ -6,6 +6,8 @@ export interface BotConfig {
     id: string;
     threads: number;
     timeout: number;
+    // written by `mtce --autotune`, calibrates the estimates so that they can be trusted to reject tasks
+    profile?: string;
 }
 
 let config: BotConfig | undefined;
@@ -25,6 +25,7 @@ export interface CharmEvalTask {
     charms: string[];
     cp: number;
     creationTime: number;
+    estimatedSeconds: number;
 }
 
 export interface RunningTask extends CharmEvalTask {
@@ -38,15 +39,20 @@ interface SpawnResult {
     stderr: Buffer;
 }
 
-async function doTask(task: CharmEvalTask, filePath: string): Promise<EvalResult> {
-    await writeFile(filePath, task.charms.join("\n"));
+type TaskParameters = Pick<CharmEvalTask, "weights" | "charms" | "cp">;
+
+function taskArgs(task: TaskParameters, filePath: string) {
+    const profile = getConfig().profile;
 
-    const spawnResult = await new Promise<SpawnResult>((resolve) => {
-        const args = [
-            "--bot-mode", "--in", filePath, "--naive-threads", getConfig().threads.toString(), "--config-charm-power", task.cp.toString(),
-            ...Object.entries(task.weights).flatMap(([k, v]) => [`--weight-${k}`, v.toString()])
-        ];
+    return [
+        "--bot-mode", "--in", filePath, "--naive-threads", getConfig().threads.toString(), "--config-charm-power", task.cp.toString(),
+        ...(profile !== undefined ? ["--naive-profile", profile] : []),
+        ...Object.entries(task.weights).flatMap(([k, v]) => [`--weight-${k}`, v.toString()])
+    ];
+}
 
+function spawnMtce(args: string[]): Promise<SpawnResult> {
+    return new Promise<SpawnResult>((resolve) => {
         logger.audit("eval_queue.spawn", {args, });
 
         const proc = spawn("./mtce", args, {
@@ -71,6 +77,32 @@ async function doTask(task: CharmEvalTask, filePath: string): Promise<EvalResult
         proc.stdout.on("data", (entry) => stdout = Buffer.concat([stdout, entry]));
         proc.stderr.on("data", (entry) => stderr = Buffer.concat([stderr, entry]));
     });
+}
+
+/**
+ * Asks the evaluator how long the task would take, without running it.
+ * @returns The predicted wall time in seconds, or undefined if the estimate failed
+ */
+async function estimateTask(task: TaskParameters, filePath: string): Promise<number | undefined> {
+    await writeFile(filePath, task.charms.join("\n"));
+
+    const spawnResult = await spawnMtce([...taskArgs(task, filePath), "--estimate"]);
+    const lines = spawnResult.stdout.toString("utf8").trim().split("\n");
+
+    if (!spawnResult.success || lines.length != 3) {
+        logger.audit("eval_queue.estimate.error", {stdout: spawnResult.stdout.toString("utf8"), stderr: spawnResult.stderr.toString("utf8"), });
+        return undefined;
+    }
+
+    const seconds = parseFloat(lines[1]);
+    logger.audit("eval_queue.estimate", {nodes: lines[0], seconds, });
+    return Number.isFinite(seconds) ? seconds : undefined;
+}
+
+async function doTask(task: CharmEvalTask, filePath: string): Promise<EvalResult> {
+    await writeFile(filePath, task.charms.join("\n"));
+
+    const spawnResult = await spawnMtce(taskArgs(task, filePath));
 
     const auditLogCommon = {
         stdout: spawnResult.stdout.toString("utf8"),
@@ -142,7 +174,8 @@ async function doTask(task: CharmEvalTask, filePath: string): Promise<EvalResult
 }
 
 export class EvalJobRunner {
-    private queue = new BlockingQueue<CharmEvalTask>();
+    // shortest job first, so small requests don't wait behind large ones
+    private queue = new BlockingQueue<CharmEvalTask>((a, b) => a.estimatedSeconds - b.estimatedSeconds);
     private currTask?: RunningTask;
 
     public async begin() {
@@ -161,12 +194,30 @@ export class EvalJobRunner {
         }
     }
 
-    public evaluate(
+    public async evaluate(
         creator: string,
         configOwner: string,
         configName: string,
         weights: Record<string, string>, charms: string[], cp: number
     ): Promise<EvalResult> {
+        const charmsFile = await createTmpFile();
+        let estimatedSeconds: number | undefined;
+
+        try {
+            estimatedSeconds = await estimateTask({weights, charms, cp, }, charmsFile.path);
+        } finally {
+            charmsFile.cleanup();
+        }
+
+        // reject hopeless tasks up front instead of letting them burn the entire timeout - but only on a profiled estimate, without one the
+        // seconds come from a default cost model that can be off by a lot on this machine, and are only good enough to order the queue
+        if (getConfig().profile !== undefined && estimatedSeconds !== undefined && estimatedSeconds > getConfig().timeout) {
+            return {
+                success: false,
+                error: `Task would take about ${Math.round(estimatedSeconds)} seconds, which exceeds the ${getConfig().timeout} second limit (try fewer charms?).`,
+            };
+        }
+
         return new Promise((resolve) => {
             this.queue.push({
                 creator, configOwner, configName,
@@ -175,6 +226,7 @@ export class EvalJobRunner {
                 charms,
                 cp,
                 creationTime: Date.now(),
+                estimatedSeconds: estimatedSeconds ?? Infinity,
             });
         });
     }
@@ -4,6 +4,7 @@
 #include "common/eval.h"
 #include <cstddef>
 #include <cstdint>
+#include <ostream>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -16,9 +17,29 @@ namespace mtce
     {
         size_t threads;
         bool enable_trace;
+        naive_profile profile;
+        bool prune_bound;
+        sched::pin_mode pin;
+        eval_shard shard;
+        bool narrow_stats;
+        naive_walk walk;
+        bool coarse;
+        bool best_first;
+        std::size_t best_first_limit;
     };
 
-    using algo_info_t = std::variant<naive_algo_flags>;
+    // the naive evaluator's strategies raced against each other, see evaluate_portfolio
+    struct portfolio_algo_flags
+    {
+        size_t threads;
+        bool enable_trace;
+        naive_profile profile;
+        bool narrow_stats;
+        naive_walk walk;
+        std::size_t best_first_limit;
+    };
+
+    using algo_info_t = std::variant<naive_algo_flags, portfolio_algo_flags>;
 
     struct config
     {
@@ -31,9 +52,9 @@ namespace mtce
 
             for (const auto& [name, value] : ability_weights)
             {
-                if (NAME_TO_ID.contains(name))
+                if (const auto id = find_effect(name))
                 {
-                    weights.at(NAME_TO_ID.at(name)) = value;
+                    weights.at(*id) = value;
                 }
             }
 
@@ -48,9 +69,30 @@ namespace mtce
         uint32_t benchmark = 0;
         algo_info_t algo;
         bool bot_mode = false;
+        bool estimate = false;
+        std::string_view autotune_file;
+        std::vector<std::string_view> merge_files;
+        std::string_view compiled_inventory_file;
+    };
+
+    // the partial result of one --shard run, as read back by --merge
+    struct shard_result
+    {
+        eval_shard shard;
+        uint64_t inventory; // fingerprint of the charms and config, shards of different inputs can't be merged
+        eval_result result;
     };
 
     auto parse_args(int argc, const char* const* argv) -> cli_options;
     void read_config(const std::string& path, config& out);
+    // reads a charm dataset, or an inventory compiled by write_inventory
     auto read_charms(const std::string& path) -> std::vector<charm>;
+    void write_inventory(const std::string& path, const std::vector<charm>& charms);
+    auto read_profile(const std::string& path) -> naive_profile;
+    void write_profile(const std::string& path, const naive_profile& profile);
+    auto inventory_fingerprint(const std::vector<charm>& charms, const config& config) -> uint64_t;
+    void write_shard_result(std::ostream& out, const shard_result& result);
+    auto read_shard_result(const std::string& path) -> shard_result;
+    // checks that every shard is present exactly once and picks the best result
+    auto merge_shard_results(const std::vector<shard_result>& shards) -> eval_result;
 } // namespace mtce
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace mtce
+{
+    // a whole file, read-only - mapped into memory where the platform allows it, and read into a buffer otherwise (or for pipes)
+    // views into it stay valid for as long as this lives
+    class mapped_file
+    {
+        const char* data = nullptr;
+        std::size_t size = 0;
+        bool opened = false;
+        bool mapped = false;
+        std::string buffer;
+
+    public:
+        explicit mapped_file(const std::string& path);
+        ~mapped_file();
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file(mapped_file&&) = delete;
+        auto operator=(const mapped_file&) -> mapped_file& = delete;
+        auto operator=(mapped_file&&) -> mapped_file& = delete;
+
+        [[nodiscard]] auto is_open() const -> bool { return opened; }
+        [[nodiscard]] auto view() const -> std::string_view { return {data, size}; }
+    };
+} // namespace mtce
@@ -1,11 +1,11 @@
 #pragma once
 
-#include "build_config.h"
 #include "common/charm.h"
 #include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <vector>
 
 // a bunch of utilities that are useful for vectorization
@@ -17,7 +17,13 @@ namespace mtce::vec
     // alignment for vectorization reasons
     inline static constexpr std::size_t ENCODED_CHARM_STAT_BITS = 26;
     inline static constexpr int32_t ENCODED_CHARM_STAT_SCALE = (1 << ENCODED_CHARM_STAT_BITS) - 1;
-    inline static constexpr std::size_t DEFAULT_VECTOR_BLOCK = VECTORIZED_BIT_SIZE / 8;
+    // the narrow (16-bit) encoding puts the cap at the top of the range, so that saturating adds cap for free
+    inline static constexpr int16_t NARROW_CHARM_STAT_SCALE = std::numeric_limits<int16_t>::max();
+    // 256 bits: one avx2 register, two sse ones - avx-512 kernels handle the odd half block separately
+    // this can't follow the cpu, since the kernel is picked at runtime
+    inline static constexpr std::size_t DEFAULT_VECTOR_BLOCK = 32;
+    // std::hardware_destructive_interference_size is not reliable across compilers, 64 is right for everything we run on
+    inline static constexpr std::size_t CACHE_LINE_SIZE = 64;
 
 #ifdef IS_LANGUAGE_SERVER
     // tunables
@@ -29,10 +35,10 @@ namespace mtce::vec
     inline constexpr std::size_t TABLE_SIZE_ALIGN = DEFAULT_VECTOR_BLOCK / sizeof(int32_t);
 #endif
 
-    template <std::size_t N>
+    template <std::size_t N, typename Lane = int32_t>
     struct alignas(CHARM_STRUCT_ALGIN) table_t
     {
-        std::array<int32_t, N> stat_table;
+        std::array<Lane, N> stat_table;
     };
 
     struct alignas(CHARM_STRUCT_ALGIN) charm_set_buffer
@@ -42,6 +48,6 @@ namespace mtce::vec
         constexpr charm_set_buffer() { std::ranges::fill(data, MISSING_ID); }
     };
 
-    template <std::size_t N>
-    using charm_buffer = std::vector<table_t<N>>;
+    template <std::size_t N, typename Lane = int32_t>
+    using charm_buffer = std::vector<table_t<N, Lane>>;
 } // namespace mtce::vec
@@ -1,12 +1,16 @@
 #pragma once
 
 #include "gen/charm_data.h"
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <optional>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <vector>
 
 namespace mtce
 {
@@ -16,23 +20,227 @@ namespace mtce
     using charm_id = std::uint32_t;
     inline static constexpr charm_id MISSING_ID = -1U;
 
+    // one nonzero stat of a charm
+    struct charm_effect
+    {
+        std::uint16_t ability;
+        double value;
+
+        auto operator==(const charm_effect&) const -> bool = default;
+    };
+
     struct charm
     {
         std::uint32_t charm_power;
         std::uint32_t color;
         std::string name;
         bool has_upgrade;
-        std::array<double, ABILITY_COUNT> charm_data;
+        // sorted by ability, without zeros - a charm has a handful of effects out of ABILITY_COUNT abilities, so this is a couple hundred
+        // bytes instead of a few KB of mostly zeros
+        std::vector<charm_effect> effects;
+
+        // 0 for an ability the charm doesn't affect
+        [[nodiscard]] auto effect(std::size_t ability) const -> double
+        {
+            const auto iter = std::ranges::lower_bound(effects, ability, {}, &charm_effect::ability);
+            return iter != effects.end() && iter->ability == ability ? iter->value : 0;
+        }
+
+        void set_effect(std::size_t ability, double value)
+        {
+            const auto iter = std::ranges::lower_bound(effects, ability, {}, &charm_effect::ability);
+            if (iter != effects.end() && iter->ability == ability)
+            {
+                if (value == 0)
+                {
+                    effects.erase(iter);
+                    return;
+                }
+
+                iter->value = value;
+            }
+            else if (value != 0)
+            {
+                effects.insert(iter, {.ability = (std::uint16_t)ability, .value = value});
+            }
+        }
+
+        void add_effect(std::size_t ability, double value) { set_effect(ability, effect(ability) + value); }
+
+        // every ability's value, for the few places that need all of them
+        [[nodiscard]] auto dense_effects() const -> std::array<double, ABILITY_COUNT>
+        {
+            std::array<double, ABILITY_COUNT> dense{};
+            for (const auto& [ability, value] : effects)
+            {
+                dense.at(ability) = value;
+            }
+
+            return dense;
+        }
     };
 
-    // no good alternative...
-    // NOLINTNEXTLINE(cert-err58-cpp)
-    inline static const std::unordered_map<std::string_view, std::uint16_t> NAME_TO_ID = []() {
-        std::unordered_map<std::string_view, std::uint16_t> map;
-        for (auto i = 0; i < ABILITY_COUNT; i++)
+    // effect name -> ability id, as a perfect hash built at compile time (hash-and-displace)
+    // a name is hashed once; its bucket picks the seed that moves it to a slot of its own, and that slot's id is checked against the name
+    namespace detail
+    {
+        inline constexpr std::size_t EFFECT_NAME_SLOTS = std::bit_ceil(ABILITY_COUNT + ABILITY_COUNT / 2);
+        inline constexpr std::size_t EFFECT_NAME_BUCKETS = std::bit_ceil(ABILITY_COUNT / 4);
+        inline constexpr std::uint16_t EMPTY_SLOT = -1;
+
+        // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+        // murmur3's finalizer, so every bit of the result depends on every bit of hash and seed
+        constexpr auto effect_name_mix(std::uint64_t hash, std::uint64_t seed) -> std::uint64_t
         {
-            map[EFFECT_NAMES.at(i)] = i;
+            hash ^= seed * 0x9e3779b97f4a7c15;
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccd;
+            hash ^= hash >> 33;
+            hash *= 0xc4ceb9fe1a85ec53;
+            hash ^= hash >> 33;
+            return hash;
         }
-        return map;
-    }();
+
+        // 8 little-endian bytes, the same in constant expressions (where the table is built) and at runtime
+        constexpr auto effect_name_word(const char* data) -> std::uint64_t
+        {
+            if consteval
+            {
+                std::uint64_t word = 0;
+                for (std::size_t i = 0; i < 8; i++)
+                {
+                    word |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data[i])) << (i * 8);
+                }
+                return word;
+            }
+            else
+            {
+                std::uint64_t word = 0;
+                std::memcpy(&word, data, sizeof(word));
+                if constexpr (std::endian::native == std::endian::big)
+                {
+                    word = std::byteswap(word);
+                }
+                return word;
+            }
+        }
+
+        // a word at a time - names are ~30 characters, and a multiply per byte made this slower than std::hash
+        constexpr auto effect_name_hash(std::string_view name) -> std::uint64_t
+        {
+            std::uint64_t hash = name.size();
+
+            if (name.size() < 8)
+            {
+                for (std::size_t i = 0; i < name.size(); i++)
+                {
+                    hash ^= static_cast<std::uint64_t>(static_cast<std::uint8_t>(name[i])) << (i * 8 + 8);
+                }
+                return effect_name_mix(hash, 0);
+            }
+
+            // the last word overlaps the one before it, instead of a byte loop over the rest
+            for (std::size_t pos = 0; pos + 8 < name.size(); pos += 8)
+            {
+                hash = (hash ^ effect_name_word(name.data() + pos)) * 0x9e3779b97f4a7c15;
+                hash ^= hash >> 32;
+            }
+
+            return effect_name_mix(hash ^ effect_name_word(name.data() + name.size() - 8), 0);
+        }
+        // NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+
+        constexpr auto effect_name_bucket(std::uint64_t hash) -> std::size_t { return hash % EFFECT_NAME_BUCKETS; }
+
+        constexpr auto effect_name_slot(std::uint64_t hash, std::uint16_t seed) -> std::size_t
+        {
+            return effect_name_mix(hash, seed) % EFFECT_NAME_SLOTS;
+        }
+
+        struct effect_name_table
+        {
+            std::array<std::uint16_t, EFFECT_NAME_BUCKETS> seeds{};
+            std::array<std::uint16_t, EFFECT_NAME_SLOTS> ids{};
+        };
+
+        consteval auto make_effect_name_table() -> effect_name_table
+        {
+            effect_name_table table;
+            table.ids.fill(EMPTY_SLOT);
+
+            std::array<std::uint64_t, ABILITY_COUNT> hashes{};
+            std::vector<std::vector<std::uint16_t>> buckets(EFFECT_NAME_BUCKETS);
+            for (std::size_t i = 0; i < ABILITY_COUNT; i++)
+            {
+                hashes[i] = effect_name_hash(EFFECT_NAMES[i]);
+                buckets[effect_name_bucket(hashes[i])].push_back(i);
+            }
+
+            // fullest buckets first, while most slots are still free
+            std::vector<std::size_t> order(EFFECT_NAME_BUCKETS);
+            for (std::size_t i = 0; i < order.size(); i++)
+            {
+                order[i] = i;
+            }
+            std::ranges::sort(order, [&](std::size_t lhs, std::size_t rhs) {
+                return buckets[lhs].size() != buckets[rhs].size() ? buckets[lhs].size() > buckets[rhs].size() : lhs < rhs;
+            });
+
+            for (const auto bucket : order)
+            {
+                const auto& members = buckets[bucket];
+                std::uint16_t seed = 1;
+
+                // the seed that places every name of the bucket in a free slot, and no two in the same one
+                for (;; seed++)
+                {
+                    if (seed == EMPTY_SLOT)
+                    {
+                        throw "no perfect hash for EFFECT_NAMES, change the table sizes";
+                    }
+
+                    std::vector<std::size_t> slots;
+                    for (const auto id : members)
+                    {
+                        const auto slot = effect_name_slot(hashes[id], seed);
+                        if (table.ids[slot] != EMPTY_SLOT || std::ranges::find(slots, slot) != slots.end())
+                        {
+                            break;
+                        }
+                        slots.push_back(slot);
+                    }
+
+                    if (slots.size() == members.size())
+                    {
+                        for (std::size_t i = 0; i < members.size(); i++)
+                        {
+                            table.ids[slots[i]] = members[i];
+                        }
+                        break;
+                    }
+                }
+
+                table.seeds[bucket] = seed;
+            }
+
+            return table;
+        }
+
+        inline constexpr effect_name_table EFFECT_NAME_TABLE = make_effect_name_table();
+    } // namespace detail
+
+    // the id of the ability called name in EFFECT_NAMES, if any
+    constexpr auto find_effect(std::string_view name) -> std::optional<std::uint16_t>
+    {
+        const auto hash = detail::effect_name_hash(name);
+        const auto seed = detail::EFFECT_NAME_TABLE.seeds[detail::effect_name_bucket(hash)];
+        const auto id = detail::EFFECT_NAME_TABLE.ids[detail::effect_name_slot(hash, seed)];
+
+        if (id == detail::EMPTY_SLOT || EFFECT_NAMES[id] != name)
+        {
+            return std::nullopt;
+        }
+
+        return id;
+    }
 } // namespace mtce
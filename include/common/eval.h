@@ -2,10 +2,13 @@
 
 #include "charm.h"
 #include "gen/charm_data.h"
+#include "topology.h"
 #include <array>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <span>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -13,12 +16,69 @@ namespace mtce
 {
     using charm_weights = std::array<std::int32_t, ABILITY_COUNT>;
 
+    // per-node cost of the naive evaluator
+    // the defaults are rough numbers for an optimized x86 build, use the autotuner to measure the actual machine
+    struct naive_cost_model
+    {
+        std::size_t threads = 0; // the thread count this was measured at, 0 if it applies to any thread count
+        double node_ns = 0.5;    // cpu time per node, at the measured thread count
+        double lane_ns = 0.5;    // additional cpu time per node per (padded) ability lane
+        double thread_spawn_ns = 50000.0;
+        std::string kernel{}; // the kernel this was measured with (see naive_kernels), empty for the active one
+    };
+
+    // measured cost models, one per kernel and thread count
+    // when present, the evaluator picks the fastest kernel and thread count for each input by itself, skipping kernels this cpu can't run
+    struct naive_profile
+    {
+        std::vector<naive_cost_model> entries;
+    };
+
+    // a slice of the search space, for spreading one evaluation over several processes
+    // shard i explores the jobs below the split depth whose index is i modulo count, the best result of all shards is the full result
+    struct eval_shard
+    {
+        uint32_t index = 0;
+        uint32_t count = 1;
+    };
+
+    // how the naive evaluator walks the tree, see INTERNALS.md
+    enum class naive_walk : uint8_t
+    {
+        automatic, // recursive, or the fastest in-place walk of this kernel for configs that weigh many abilities
+        recursive, // a copy of the stats per node
+        // one table per worker that charms are added to and subtracted from
+        in_place,
+        // the in-place walk on each charm's nonzero lanes only, with the utility updated from the lanes a charm touches
+        // O(effects per charm) per node instead of O(abilities)
+        sparse,
+        // the in-place walk on 8-lane tiles, keeping the utility of every tile - a charm only touches the tiles it has effects in
+        tiled,
+    };
+
+    // 64 bytes each
+    inline constexpr std::size_t BEST_FIRST_LIMIT = 1 << 20;
+
     struct eval_config
     {
         std::vector<charm> charms;
         uint32_t max_cp;
         charm_weights weights;
-        std::size_t threads;
+        std::size_t threads; // 0 picks the fastest thread count for the input, see naive_profile
+        naive_profile profile{};
+        bool prune_bound = false; // branch-and-bound on the best utility found by any worker
+        sched::pin_mode pin = sched::pin_mode::none;
+        eval_shard shard{};
+        // 16-bit saturating stats, twice the lanes per vector - only used where that ranks sets the same as 32-bit stats up to rounding,
+        // the reported utility is the 32-bit one of the picked set
+        bool narrow_stats = false;
+        naive_walk walk = naive_walk::automatic;
+        // check every job with an 8-bit over-estimate of its subtree first, and only evaluate the ones that might beat the best set
+        bool coarse = false;
+        // expand the partial set with the best bound first, on one thread, and stop as soon as that proves the best set optimal
+        // past best_first_limit queued sets it falls back to the depth-first walk with the bound
+        bool best_first = false;
+        std::size_t best_first_limit = BEST_FIRST_LIMIT;
     };
 
     struct eval_result
@@ -30,7 +90,57 @@ namespace mtce
     struct naive_tracing_config 
     {
         std::function<void(std::vector<std::string_view>& abilities, std::vector<std::string_view>& charms)> trace_prune;
+        // called for parallel runs with pinning enabled, workers[i] is the cpu worker i runs on
+        std::function<void(const sched::cpu_topology& topology, std::span<const sched::cpu_info> workers, sched::pin_mode mode)> trace_placement;
+        // called when narrow stats were asked for: whether they were used, and how far below the optimum the picked set can be
+        std::function<void(bool narrow, int64_t max_gap)> trace_encoding;
+        // called by evaluate_portfolio once the race is over, for each engine in turn
+        std::function<void(std::string_view engine, std::size_t threads, bool won)> trace_engine;
     };
 
+    struct eval_estimate
+    {
+        uint64_t nodes;
+        std::size_t abilities;
+        std::size_t lanes;
+        std::size_t charms;
+        std::size_t threads;
+        double seconds;
+        std::string_view kernel;
+    };
+
+    struct autotune_options
+    {
+        std::size_t max_threads;
+        std::function<void(const naive_cost_model& model)> on_measured;
+    };
+
+    // the evaluator runs its workers on a process-wide pool, which grows on demand and stays parked between evaluations
+    // long-lived hosts can size it once up front, so that no request pays for thread creation
+    void set_eval_pool_size(std::size_t threads);
+    auto eval_pool_size() -> std::size_t;
+
+    // the evaluator is built once per instruction set (avx-512, avx2, sse4.2 and a generic fallback), the best one the cpu supports is
+    // picked on first use
+    // the kernels this cpu can run, best first
+    auto naive_kernels() -> std::vector<std::string_view>;
+    auto naive_kernel_name() -> std::string_view;
+    // forces a kernel for every later evaluation whose profile doesn't pick one, false if this cpu can't run it
+    auto set_naive_kernel(std::string_view name) -> bool;
+
     auto evaluate_naive(const eval_config& config, const naive_tracing_config& trace = {}) -> eval_result;
+
+    // runs several strategies of the naive evaluator at once, splitting config.threads between them, and returns the result of the first
+    // one to finish - every one of them is exhaustive, so finishing proves its set optimal and stops the others
+    // they share the best utility found so far for pruning, and all of them break ties among the same candidate sets (every walk skips
+    // the same redundant charms), so the result is the same whichever one wins
+    // config.prune_bound, config.coarse and config.best_first are up to the portfolio, config.pin and config.shard are ignored
+    auto evaluate_portfolio(const eval_config& config, const naive_tracing_config& trace = {}) -> eval_result;
+
+    // predicts the cost of evaluate_naive without running it, by counting the charm sets that fit the cp and slot constraints
+    auto estimate_naive(const eval_config& config) -> eval_estimate;
+
+    // measures the per-node cost of the naive evaluator on this machine for each kernel in naive_kernels and each thread count up to
+    // options.max_threads
+    auto autotune_naive(const autotune_options& options) -> naive_profile;
 } // namespace mtce
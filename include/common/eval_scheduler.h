@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common/eval.h"
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+
+namespace mtce
+{
+    using requester_id = std::uint64_t;
+
+    // runs evaluations from many requesters at once on one set of workers
+    // every evaluation is split into its top-level jobs, and an idle worker takes the next job of the requester that used the least worker
+    // time relative to its share, so a small request never waits for a large one to finish while no worker ever idles with jobs left
+    // the workers are a batch on the process-wide pool (sched::global_pool), started while jobs are queued - the pool has no way to
+    // start a batch without waiting for it, so one thread of the scheduler's own starts them and runs in each as worker 0
+    class eval_scheduler
+    {
+        struct state;
+        std::unique_ptr<state> impl;
+
+    public:
+        explicit eval_scheduler(std::size_t threads);
+
+        // stops the workers once their current jobs are done, evaluations that haven't finished are abandoned (their futures report a
+        // broken promise)
+        ~eval_scheduler();
+
+        eval_scheduler(const eval_scheduler&) = delete;
+        eval_scheduler(eval_scheduler&&) = delete;
+        auto operator=(const eval_scheduler&) -> eval_scheduler& = delete;
+        auto operator=(eval_scheduler&&) -> eval_scheduler& = delete;
+
+        // the relative share of worker time a requester gets while others are busy too, 1 unless set
+        void set_share(requester_id requester, std::uint32_t share);
+
+        // config.threads and config.pin are ignored, the workers are shared by every evaluation
+        // the charm data is prepared on the calling thread
+        auto submit(requester_id requester, const eval_config& config) -> std::future<eval_result>;
+
+        [[nodiscard]] auto size() const -> std::size_t;
+        // requesters with evaluations queued or running, or a share other than 1 - the others are forgotten
+        [[nodiscard]] auto requester_count() const -> std::size_t;
+    };
+} // namespace mtce
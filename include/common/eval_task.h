@@ -0,0 +1,36 @@
+#pragma once
+
+#include "common/eval.h"
+#include <cstddef>
+#include <memory>
+
+namespace mtce::sched
+{
+    // one evaluation, split into jobs that can run in any order and on any worker
+    // the evaluation-specific state (tables, per-worker buffers) lives behind this, so that a scheduler can mix evaluations of any width
+    class eval_task
+    {
+    public:
+        eval_task() = default;
+        eval_task(const eval_task&) = delete;
+        eval_task(eval_task&&) = delete;
+        auto operator=(const eval_task&) -> eval_task& = delete;
+        auto operator=(eval_task&&) -> eval_task& = delete;
+        virtual ~eval_task() = default;
+
+        [[nodiscard]] virtual auto job_count() const -> std::size_t = 0;
+
+        // jobs of one task may run concurrently, but each worker index must only be used by one thread at a time
+        virtual void run_job(std::size_t job, std::size_t worker) = 0;
+
+        // the result of the evaluation, only valid once every job ran
+        virtual auto finish() -> eval_result = 0;
+    };
+} // namespace mtce::sched
+
+namespace mtce
+{
+    // prepares an evaluation for a scheduler with the given number of workers, config.threads and config.pin are ignored
+    // the nodes above the split depth are evaluated right away, on the calling thread
+    auto make_naive_task(const eval_config& config, std::size_t workers) -> std::unique_ptr<sched::eval_task>;
+} // namespace mtce
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "common/aligned_eval.h"
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace mtce::sched
+{
+    // the best utility found so far by any worker, readable by all of them for pruning
+    // sits on its own cache line, since every worker reads it all the time and writes to it only rarely
+    struct alignas(vec::CACHE_LINE_SIZE) shared_incumbent
+    {
+        std::atomic<int64_t> value{std::numeric_limits<int64_t>::min()};
+
+        [[nodiscard]] auto load() const -> int64_t { return value.load(std::memory_order_relaxed); }
+
+        // raises the incumbent to candidate if that is an improvement, writing only in that case
+        auto offer(int64_t candidate) -> bool
+        {
+            auto curr = value.load(std::memory_order_relaxed);
+            while (candidate > curr)
+            {
+                if (value.compare_exchange_weak(curr, candidate, std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    };
+
+    // evaluations of the same input racing each other: they all prune with one incumbent, and give up once one of them sets stop
+    // an evaluation only checks stop between jobs, so it can run for up to one job after
+    struct eval_race
+    {
+        shared_incumbent incumbent;
+        std::atomic<bool> stop{false};
+
+        [[nodiscard]] auto stopped() const -> bool { return stop.load(std::memory_order_relaxed); }
+    };
+} // namespace mtce::sched
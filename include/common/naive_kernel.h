@@ -0,0 +1,138 @@
+#pragma once
+
+// internal to the naive evaluator: the pieces shared between eval_naive.cpp and the per-isa builds of naive_kernel.inc
+// the kernel body is compiled with a different target than the rest of the program, so every header it needs is included here, before
+// the target is switched - standard templates instantiated from the kernel then keep the baseline target in every translation unit
+
+#include "common/aligned_eval.h"
+#include "common/charm.h"
+#include "common/eval.h"
+#include "common/eval_task.h"
+#include "common/incumbent.h"
+#include "common/thread_pool.h"
+#include "common/topology.h"
+#include "common/work_stealing.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MTCE_X86_KERNELS 1
+#endif
+
+// every ability count up to this gets an evaluator of its own width, wider configs share a few (see static_abilities)
+// set by the max_static_abilities meson option
+#ifndef MTCE_MAX_STATIC_ABILITIES
+#define MTCE_MAX_STATIC_ABILITIES 64
+#endif
+
+#define MTCE_ISA_GENERIC 0
+#define MTCE_ISA_SSE42 1
+#define MTCE_ISA_AVX2 2
+#define MTCE_ISA_AVX512 3
+
+namespace mtce::kernel
+{
+    using internal_result_t = std::pair<int64_t, vec::charm_set_buffer>;
+
+    inline constexpr std::size_t MAX_STATIC_ABILITIES = MTCE_MAX_STATIC_ABILITIES;
+
+    // the ability count the evaluator for a config with `abilities` abilities is built for
+    // past MAX_STATIC_ABILITIES, widths double (up to every ability), so a wide config does at most twice the work it needs to
+    constexpr auto static_abilities(std::size_t abilities) -> std::size_t
+    {
+        if (abilities <= MAX_STATIC_ABILITIES)
+        {
+            return abilities;
+        }
+
+        auto width = std::max<std::size_t>(MAX_STATIC_ABILITIES, 1);
+        while (width < abilities)
+        {
+            width *= 2;
+        }
+
+        return std::min(width, ABILITY_COUNT);
+    }
+
+    struct charm_compact_dyn
+    {
+        charm_id original_index{};
+        uint32_t charm_power{};
+        bool has_upgrade{};
+        std::vector<int32_t> stat_table;
+        std::vector<int16_t> narrow_table; // the same stats on the NARROW_CHARM_STAT_SCALE scale
+    };
+
+    struct eval_options
+    {
+        uint32_t max_cp;
+        size_t n_threads;
+        bool prune_bound;
+        naive_walk walk;
+        bool coarse;
+        bool best_first;
+        size_t best_first_limit;
+        std::span<const sched::cpu_info> placement;
+        bool replicate;
+        eval_shard shard;
+        sched::eval_race* race; // null unless this is one engine of evaluate_portfolio
+    };
+
+    using eval_charm_delegate_t =
+        internal_result_t (*)(const std::vector<charm_compact_dyn>& charms, const std::vector<int32_t>& weights, const eval_options& options);
+
+    using make_task_delegate_t = std::unique_ptr<sched::eval_task> (*)(
+        const std::vector<charm_compact_dyn>& charms, const std::vector<int32_t>& weights, const eval_options& options, size_t workers
+    );
+
+    // one build of the evaluator, every table is indexed by the number of important abilities
+    struct naive_kernel
+    {
+        std::string_view name;
+        std::span<const eval_charm_delegate_t> eval;
+        std::span<const make_task_delegate_t> make_task;
+        // on 16-bit saturating stats, see narrow_stats in eval_config
+        std::span<const eval_charm_delegate_t> eval_narrow;
+        std::span<const make_task_delegate_t> make_task_narrow;
+    };
+
+    // translate static result -> dynamic result
+    auto to_eval_result(const internal_result_t& result, const std::vector<charm_id>& original_index) -> eval_result;
+
+    namespace generic
+    {
+        extern const naive_kernel KERNEL;
+    } // namespace generic
+
+#ifdef MTCE_X86_KERNELS
+    namespace sse42
+    {
+        extern const naive_kernel KERNEL;
+    } // namespace sse42
+
+    namespace avx2
+    {
+        extern const naive_kernel KERNEL;
+    } // namespace avx2
+
+    namespace avx512
+    {
+        extern const naive_kernel KERNEL;
+    } // namespace avx512
+#endif
+} // namespace mtce::kernel
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mtce::sched
+{
+    // a set of worker threads parked on a condition variable between batches, so that each evaluation doesn't pay for thread creation
+    // the calling thread takes part in every batch as worker 0, the pool provides the rest
+    // batches may run concurrently, and a worker may start a batch of its own (evaluate_portfolio runs parallel engines on the pool)
+    class worker_pool
+    {
+        struct batch
+        {
+            const std::function<void(size_t)>* fn;
+            size_t workers;
+            size_t next = 1; // the next worker index to hand out
+            size_t pending;  // workers other than the calling thread that haven't finished
+        };
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::vector<std::thread> threads;
+
+        std::deque<batch*> open; // batches with worker indices left to hand out, oldest first
+        size_t unclaimed = 0;    // worker indices left in open
+        size_t idle = 0;         // threads not running a batch
+        size_t running = 0;      // batches that haven't finished
+        bool stopping = false;
+        bool resizing = false;
+
+        void worker_main();
+        void spawn(size_t count);
+
+    public:
+        explicit worker_pool(size_t threads = 0);
+        ~worker_pool();
+
+        worker_pool(const worker_pool&) = delete;
+        worker_pool(worker_pool&&) = delete;
+        auto operator=(const worker_pool&) -> worker_pool& = delete;
+        auto operator=(worker_pool&&) -> worker_pool& = delete;
+
+        // the number of workers a batch can use without growing the pool, including the calling thread
+        [[nodiscard]] auto size() -> size_t;
+        // waits for running batches to finish
+        void resize(size_t workers);
+
+        // runs fn(i) for i in [0, workers) concurrently, and returns once all of them are done
+        // the pool grows if it doesn't have a thread to spare for every worker, a single worker runs on the calling thread without touching
+        // the pool
+        void run(size_t workers, const std::function<void(size_t)>& fn);
+    };
+
+    // the process-wide pool used by the evaluators
+    auto global_pool() -> worker_pool&;
+} // namespace mtce::sched
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace mtce::sched
+{
+    // how evaluation workers are placed on the machine
+    enum class pin_mode : uint8_t
+    {
+        none,  // workers float, the os decides
+        cores, // one worker per physical core first, smt siblings only once every core is taken
+        numa,  // like cores, and every numa node gets its own copy of the evaluation tables
+    };
+
+    struct cpu_info
+    {
+        unsigned cpu = 0;
+        unsigned core = 0;    // physical core, unique across packages
+        unsigned package = 0; // socket
+        unsigned node = 0;    // numa node
+        bool smt_sibling = false; // another logical cpu of the same core comes earlier in the placement order
+    };
+
+    struct cpu_topology
+    {
+        std::vector<cpu_info> cpus; // in placement order: the first logical cpu of every core, then the remaining smt siblings
+        std::size_t cores = 0;
+        std::size_t nodes = 0;
+    };
+
+    // orders logical cpus for placement
+    // cores are grouped by numa node, so that a small worker count touches as few nodes (and table replicas) as possible
+    auto make_topology(std::vector<cpu_info> cpus) -> cpu_topology;
+
+    // the logical cpus this process may run on, read from sysfs
+    // falls back to a flat topology (every cpu its own core, one node) where that isn't available
+    auto system_topology() -> const cpu_topology&;
+
+    // the cpu each of workers workers should run on, wrapping around if there are more workers than cpus
+    auto place_workers(const cpu_topology& topology, std::size_t workers) -> std::vector<cpu_info>;
+
+    // pins the calling thread to a single cpu, restoring the previous affinity when destroyed
+    // pool threads outlive an evaluation, and the next one might not want them pinned
+    class scoped_affinity
+    {
+#ifdef __linux__
+        std::optional<cpu_set_t> previous;
+#endif
+
+    public:
+        explicit scoped_affinity(unsigned cpu);
+        ~scoped_affinity();
+
+        scoped_affinity(const scoped_affinity&) = delete;
+        scoped_affinity(scoped_affinity&&) = delete;
+        auto operator=(const scoped_affinity&) -> scoped_affinity& = delete;
+        auto operator=(scoped_affinity&&) -> scoped_affinity& = delete;
+
+        // false if the os refused (or doesn't support) pinning, the thread then keeps floating
+        [[nodiscard]] auto pinned() const -> bool;
+    };
+} // namespace mtce::sched
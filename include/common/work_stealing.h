@@ -0,0 +1,94 @@
+#pragma once
+
+#include "common/aligned_eval.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace mtce::sched
+{
+    // a contiguous range of job indices, popped from the front by its owner and stolen from the back by everyone else
+    // [begin, end) is packed into a single word so that both ends can be claimed with one CAS
+    // job indices are never handed out twice, so a range can't come back to a previously seen value (no ABA)
+    struct alignas(vec::CACHE_LINE_SIZE) work_range
+    {
+        std::atomic<uint64_t> range{0};
+
+        static constexpr auto pack(uint32_t begin, uint32_t end) -> uint64_t { return ((uint64_t)begin << 32) | end; }
+        static constexpr auto begin_of(uint64_t range) -> uint32_t { return range >> 32; }
+        static constexpr auto end_of(uint64_t range) -> uint32_t { return (uint32_t)range; }
+
+        // only valid while nobody else can observe the range
+        void assign(uint32_t begin, uint32_t end) { range.store(pack(begin, end), std::memory_order_relaxed); }
+
+        [[nodiscard]] auto size() const -> uint32_t
+        {
+            auto curr = range.load(std::memory_order_relaxed);
+            return begin_of(curr) < end_of(curr) ? end_of(curr) - begin_of(curr) : 0;
+        }
+
+        // owner only
+        auto pop(uint32_t& job) -> bool
+        {
+            auto curr = range.load(std::memory_order_acquire);
+            while (begin_of(curr) < end_of(curr))
+            {
+                if (range.compare_exchange_weak(curr, pack(begin_of(curr) + 1, end_of(curr)), std::memory_order_acq_rel))
+                {
+                    job = begin_of(curr);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // takes the back half of this range, returning its first job and handing the rest to the (empty) range of the thief
+        auto steal_into(work_range& thief, uint32_t& job) -> bool
+        {
+            auto curr = range.load(std::memory_order_acquire);
+            while (begin_of(curr) < end_of(curr))
+            {
+                auto mid = begin_of(curr) + (end_of(curr) - begin_of(curr)) / 2;
+                if (range.compare_exchange_weak(curr, pack(begin_of(curr), mid), std::memory_order_acq_rel))
+                {
+                    job = mid;
+                    thief.range.store(pack(mid + 1, end_of(curr)), std::memory_order_release);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    };
+
+    // runs jobs from ranges[worker] until every range is drained, stealing from the fullest range whenever our own runs dry
+    template <typename Fn>
+    void run_work_stealing(std::span<work_range> ranges, size_t worker, Fn&& run_job)
+    {
+        auto& own = ranges[worker];
+        uint32_t job = 0;
+
+        while (true)
+        {
+            while (own.pop(job))
+            {
+                run_job(job);
+            }
+
+            // the only jobs an all-empty scan can miss are the ones a thief is moving into its own range, and it runs those itself
+            auto victim = std::ranges::max_element(ranges, {}, [](const work_range& range) { return range.size(); });
+            if (victim->size() == 0)
+            {
+                return;
+            }
+
+            if (victim->steal_into(own, job))
+            {
+                run_job(job);
+            }
+        }
+    }
+} // namespace mtce::sched
@@ -0,0 +1,45 @@
+# per-width code size of the naive evaluator: sums the symbols of every (isa, lane type, table width) build in a binary
+# usage: python misc/kernel_sizes.py <binary>, or `meson compile kernel-sizes`
+# the widths that configs actually use should be small enough to stay in the instruction cache, see max_static_abilities
+
+import re
+import subprocess
+import sys
+from collections import defaultdict
+
+# everything in the kernel namespaces that is templated on <width, lane>, the first such argument list is the build it belongs to
+SYMBOL = re.compile(r"mtce::kernel::(\w+)::.*?<(\d+)ul?, (int|short)>")
+LANES = {"int": "int32", "short": "int16"}
+
+
+def sizes(binary: str) -> dict[tuple[str, str, int], int]:
+    out = subprocess.run(["nm", "-C", "-S", "--size-sort", binary], check=True, capture_output=True, text=True).stdout
+    total: dict[tuple[str, str, int], int] = defaultdict(int)
+
+    for line in out.splitlines():
+        parts = line.split(" ", 3)
+        if len(parts) < 4 or parts[2] not in "tTwW":
+            continue
+
+        match = SYMBOL.search(parts[3])
+        if match:
+            total[(match[1], LANES[match[3]], int(match[2]))] += int(parts[1], 16)
+
+    return total
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(f"usage: {sys.argv[0]} <binary>", file=sys.stderr)
+        sys.exit(1)
+
+    total = sizes(sys.argv[1])
+    print(f"{'kernel':<8} {'lanes':<6} {'width':>5} {'bytes':>9}")
+    for (isa, lane, width), size in sorted(total.items()):
+        print(f"{isa:<8} {lane:<6} {width:>5} {size:>9}")
+
+    print(f"{len(total)} builds, {sum(total.values())} bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,109 @@
+// times the naive evaluator on synthetic inventories of growing width, with every way of walking the tree
+// usage: mtce-width-sweep [runs] [kernel], prints the best of `runs` single-threaded runs in seconds
+
+#include "common/charm.h"
+#include "common/eval.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace mtce;
+
+namespace
+{
+    inline constexpr std::array<size_t, 6> WIDTHS = {8, 16, 32, 64, 128, 256};
+    inline constexpr size_t CHARM_COUNT = 60;
+    inline constexpr size_t EFFECTS_PER_CHARM = 6;
+    // the effects of a real charm belong to one class, whose abilities end up next to each other once unweighted ones are dropped
+    inline constexpr size_t CLASS_ABILITIES = 16;
+
+    struct walk
+    {
+        std::string_view name;
+        naive_walk mode;
+    };
+
+    inline constexpr std::array<walk, 4> WALKS = {{
+        {.name = "recursive", .mode = naive_walk::recursive},
+        {.name = "in-place", .mode = naive_walk::in_place},
+        {.name = "sparse", .mode = naive_walk::sparse},
+        {.name = "tiled", .mode = naive_walk::tiled},
+    }};
+
+    // a handful of effects per charm, within one class of the first `abilities` abilities - mostly gains, like real charms
+    auto make_config(size_t abilities) -> eval_config
+    {
+        std::mt19937 rng(abilities);
+        eval_config config{.max_cp = CHARM_POWER_MAX, .weights = {}, .threads = 1};
+
+        for (size_t i = 0; i < abilities; i++)
+        {
+            config.weights.at(i) = (int32_t)(1 + rng() % 9);
+        }
+
+        for (size_t c = 0; c < CHARM_COUNT; c++)
+        {
+            charm instance{.charm_power = (uint32_t)(1 + rng() % 5)};
+            const auto first = rng() % abilities / CLASS_ABILITIES * CLASS_ABILITIES;
+            for (size_t k = 0; k < EFFECTS_PER_CHARM; k++)
+            {
+                const auto ability = std::min(first + (rng() % CLASS_ABILITIES), abilities - 1);
+                const auto sign = rng() % 4 == 0 ? -1.0 : 1.0;
+                instance.set_effect(ability, sign * (double)(rng() % 30) / 100.0 * EFFECT_CAPS.at(ability));
+            }
+            config.charms.push_back(instance);
+        }
+
+        return config;
+    }
+} // namespace
+
+auto main(int argc, char** argv) -> int
+{
+    const size_t runs = argc > 1 ? std::stoul(argv[1]) : 3;
+    if (argc > 2 && !set_naive_kernel(argv[2]))
+    {
+        std::println(std::cerr, "unknown kernel: {}", argv[2]);
+        return 1;
+    }
+
+    std::println(std::cout, "kernel: {}, {} charms, {} cp, best of {} runs", naive_kernel_name(), CHARM_COUNT, CHARM_POWER_MAX, runs);
+    std::print(std::cout, "{:>6}", "width");
+    for (const auto& mode : WALKS)
+    {
+        std::print(std::cout, "{:>12}", mode.name);
+    }
+    std::println(std::cout, "");
+
+    for (const auto width : WIDTHS)
+    {
+        auto config = make_config(width);
+        std::print(std::cout, "{:>6}", width);
+
+        for (const auto& mode : WALKS)
+        {
+            config.walk = mode.mode;
+
+            double best = 0;
+            for (size_t run = 0; run < runs; run++)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                evaluate_naive(config);
+                const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                best = run == 0 ? seconds : std::min(best, seconds);
+            }
+
+            std::print(std::cout, "{:>12.4f}", best);
+        }
+
+        std::println(std::cout, "");
+    }
+}
@@ -1,9 +1,13 @@
 #include "cli/cli.h"
 #include "build_config.h"
+#include "cli/mapped_file.h"
 #include "cli/sv_manip.h"
 #include "common/charm.h"
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <charconv>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -34,11 +38,36 @@ namespace mtce
             std::println(out, "  --config, -c [file]      specify configuration file");
             std::println(out, "  --in, -i [file]          specify input file");
             std::println(out, "  --algo [name]            specify the charm evaluation algorithm");
+            std::println(out, "                           available options: naive, portfolio (races the naive strategies on a split of");
+            std::println(out, "                           the threads, and stops at the first optimum proven)");
             std::println(out, "  --benchmark [n]          enables benchmarking mode, specifying number of times to run for data");
-            std::println(out, "                           available options: naive");
+            std::println(out, "  --estimate               predict the cost of the evaluation instead of running it");
+            std::println(out, "  --autotune [file]        measure this machine and write a profile for --naive-profile");
+            std::println(out, "  --merge [file]           combine the partial results of --shard runs (repeat for every shard)");
+            std::println(out, "  --compile-inventory [file]");
+            std::println(out, "                           write the charms of --in to a binary inventory, which --in loads without parsing");
             std::println(out, "algorithm specific flags:");
-            std::println(out, "  --naive-threads [n]      [naive] specifies the number of threads to use");
-            std::println(out, "  --naive-trace            [naive] enables tracing of pruning & other optimizations");
+            std::println(out, "  --naive-threads [n]      [naive, portfolio] specifies the number of threads to use");
+            std::println(out, "  --naive-trace            [naive, portfolio] enables tracing of pruning & other optimizations");
+            std::println(out, "  --naive-bound            [naive] prunes subtrees that can't beat the best set found so far");
+            std::println(out, "  --naive-int16            [naive, portfolio] uses 16-bit saturating stats where that is exact up to rounding,");
+            std::println(out, "                           see --naive-trace");
+            std::println(out, "  --naive-walk [mode]      [naive, portfolio] how the search tree is walked, auto picks sparse or tiled when");
+            std::println(out, "                           many abilities are weighed and recursive otherwise");
+            std::println(out, "                           available modes: auto, recursive, in-place, sparse, tiled");
+            std::println(out, "  --naive-coarse           [naive] skips the parts of the search that an 8-bit estimate proves can't win");
+            std::println(out, "  --naive-best-first       [naive] looks at the most promising sets first, and stops once the best one is proven");
+            std::println(out, "                           single-threaded, fast when one ability dominates the weights");
+            std::println(out, "  --naive-queue-limit [n]  [naive, portfolio] how many sets best-first search may queue before it falls back");
+            std::println(out, "                           to the usual search, {} by default", BEST_FIRST_LIMIT);
+            std::println(out, "  --naive-profile [file]   [naive, portfolio] picks the kernel and thread count from a profile written by");
+            std::println(out, "                           --autotune, unless --naive-kernel or --naive-threads is given");
+            std::println(out, "  --shard [i/n]            [naive] only explore slice i of n of the search space, and print a partial result");
+            std::println(out, "                           for --merge");
+            std::println(out, "  --pin [mode]             [naive] pins workers to cpus, one per physical core before smt siblings");
+            std::println(out, "                           available modes: none, cores, numa (cores + node-local table copies)");
+            std::println(out, "  --naive-kernel [isa]     [naive, portfolio] overrides the simd kernel picked for this cpu");
+            std::println(out, "                           available kernels: avx512, avx2, sse4.2, generic");
         }
 
         auto parse_arg_generic(std::string_view arg, int& idx, int argc, const char* const* argv) -> std::string_view
@@ -97,36 +126,195 @@ namespace mtce
             return res;
         }
 
-        constexpr auto create_charm(
-            uint8_t charm_power, uint32_t color, std::string name, bool has_upgrade, std::span<const size_t> index_map, std::string_view values,
-            size_t line_no
-        ) -> charm
+        template <typename... Args>
+        void check(bool predicate, const std::format_string<Args...>& fmt, Args&&... args)
         {
-            charm instance{
-                .charm_power = charm_power,
-                .color = color,
-                .name = std::move(name),
-                .has_upgrade = has_upgrade,
+            if (!predicate)
+            {
+                std::println(std::cerr, fmt, std::forward<Args>(args)...);
+                std::exit(-1);
+            }
+        }
+
+        // a charm dataset, split at ';', ':' and line ends in one pass, as views into the text
+        class charm_tokenizer
+        {
+            std::string_view text;
+            size_t pos = 0;
+
+        public:
+            struct token
+            {
+                std::string_view text;
+                char end; // the delimiter after it, '\n' for the end of the text as well
             };
 
-            auto entries = split_string_view(values, ':');
+            explicit charm_tokenizer(std::string_view text) : text(text) {}
+
+            [[nodiscard]] auto done() const -> bool { return pos >= text.size(); }
+
+            // only valid while not done, or right after a ';' or ':'
+            auto next() -> token
+            {
+                const auto end = find_first_of<';', ':', '\n'>(text, pos);
+                token result{.text = text.substr(pos, end - pos), .end = end < text.size() ? text[end] : '\n'};
+                pos = end + 1;
+                return result;
+            }
+
+            // everything up to the next ';' or line end - a name may contain ':'
+            auto next_field() -> token
+            {
+                auto field = next();
+                while (field.end == ':')
+                {
+                    const auto more = next();
+                    field = {.text = {field.text.data(), static_cast<size_t>(more.text.data() + more.text.size() - field.text.data())}, .end = more.end};
+                }
 
-            for (size_t i = 0; i < index_map.size(); i++)
+                return field;
+            }
+        };
+
+        // reads one value per effect into instance, and returns the delimiter after the last one
+        auto read_effect_values(charm_tokenizer& tokens, std::span<const size_t> effect_ids, charm& instance, size_t line_no) -> char
+        {
+            instance.effects.reserve(effect_ids.size());
+
+            charm_tokenizer::token value{.text = {}, .end = ':'};
+            size_t count = 0;
+            while (value.end == ':')
             {
-                instance.charm_data.at(index_map[i]) = read_charm_val<float>(line_no, entries[i]);
+                value = tokens.next();
+                check(count < effect_ids.size(), "bad charm data on line {}: more values than effects", line_no);
+                instance.set_effect(effect_ids[count++], read_charm_val<float>(line_no, value.text));
             }
 
-            return instance;
+            check(count == effect_ids.size(), "bad charm data on line {}: fewer values than effects", line_no);
+            return value.end;
         }
 
-        template <typename... Args>
-        void check(bool predicate, const std::format_string<Args...>& fmt, Args&&... args)
+        // a compiled inventory, written by --compile-inventory: header, effects, charms, names - every section 8-byte aligned, in native
+        // byte order (a file from a machine with the other byte order fails the version check)
+        // starts with a byte no charm dataset can start with, so read_charms tells the two apart by the first bytes
+        inline constexpr std::array INVENTORY_MAGIC = {'\x7f', 'M', 'T', 'C', 'E', 'I', 'N', 'V'};
+        inline constexpr uint32_t INVENTORY_VERSION = 1;
+
+        struct inventory_header
         {
-            if (!predicate)
+            std::array<char, 8> magic;
+            uint32_t version;
+            uint32_t charm_count;
+            uint64_t schema; // inventory_schema() of the build that wrote it
+            uint32_t effect_count;
+            uint32_t names_size;
+        };
+
+        // laid out like charm_effect, so a charm's effects are copied in one go
+        struct inventory_effect
+        {
+            uint16_t ability;
+            std::array<uint16_t, 3> reserved;
+            double value;
+        };
+
+        struct inventory_charm
+        {
+            uint32_t charm_power;
+            uint32_t color;
+            uint32_t first_effect;
+            uint32_t effect_count;
+            uint32_t name_offset;
+            uint32_t name_size;
+            uint32_t has_upgrade; // the upgraded version is the next charm
+            uint32_t reserved;
+        };
+
+        static_assert(sizeof(inventory_header) == 32 && sizeof(inventory_charm) == 32);
+        static_assert(sizeof(inventory_effect) == sizeof(charm_effect) && offsetof(inventory_effect, value) == offsetof(charm_effect, value));
+
+        // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+        // abilities are stored by id, so an inventory is only valid for the effect list it was compiled against
+        consteval auto inventory_schema() -> uint64_t
+        {
+            // fnv-1a
+            uint64_t hash = 0xcbf29ce484222325;
+            auto mix = [&](uint8_t byte) { hash = (hash ^ byte) * 0x100000001b3; };
+
+            for (const auto name : EFFECT_NAMES)
             {
-                std::println(std::cerr, fmt, std::forward<Args>(args)...);
-                std::exit(-1);
+                for (const auto ch : name)
+                {
+                    mix(ch);
+                }
+                mix(0);
+            }
+
+            return hash;
+        }
+        // NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+
+        auto read_inventory(std::string_view data, const std::string& path) -> std::vector<charm>
+        {
+            check(data.size() >= sizeof(inventory_header), "truncated inventory {}", path);
+
+            inventory_header header{};
+            std::memcpy(&header, data.data(), sizeof(header));
+            check(header.version == INVENTORY_VERSION, "inventory {} has unsupported version {}, recompile it", path, header.version);
+            check(header.schema == inventory_schema(), "inventory {} was compiled for a different effect list, recompile it", path);
+
+            const auto effects_offset = sizeof(inventory_header);
+            const auto charms_offset = effects_offset + (size_t)header.effect_count * sizeof(inventory_effect);
+            const auto names_offset = charms_offset + (size_t)header.charm_count * sizeof(inventory_charm);
+            check(data.size() == names_offset + header.names_size, "inventory {} is truncated or corrupt", path);
+
+            const auto names = data.substr(names_offset);
+
+            std::vector<charm> res;
+            res.reserve(header.charm_count);
+
+            auto entry_at = [&](size_t i) {
+                inventory_charm entry{};
+                std::memcpy(&entry, data.data() + charms_offset + i * sizeof(inventory_charm), sizeof(entry));
+                return entry;
+            };
+
+            for (size_t i = 0; i < header.charm_count; i++)
+            {
+                const auto entry = entry_at(i);
+                // the evaluator relies on the halves of an upgrade pair costing the same, as the text parser makes them
+                check(
+                    (size_t)entry.first_effect + entry.effect_count <= header.effect_count &&
+                        (size_t)entry.name_offset + entry.name_size <= header.names_size && entry.charm_power <= CHARM_POWER_MAX &&
+                        (entry.has_upgrade == 0 || (i + 1 < header.charm_count && entry_at(i + 1).charm_power == entry.charm_power)),
+                    "inventory {} is corrupt at charm {}", path, i
+                );
+
+                auto& instance = res.emplace_back(charm{
+                    .charm_power = entry.charm_power,
+                    .color = entry.color,
+                    .name = std::string(names.substr(entry.name_offset, entry.name_size)),
+                    .has_upgrade = entry.has_upgrade != 0,
+                });
+
+                instance.effects.resize(entry.effect_count);
+                std::memcpy(
+                    instance.effects.data(), data.data() + effects_offset + entry.first_effect * sizeof(inventory_effect),
+                    entry.effect_count * sizeof(inventory_effect)
+                );
+
+                // effect() and set_effect() rely on this
+                for (size_t j = 0; j < instance.effects.size(); j++)
+                {
+                    const auto& effect = instance.effects[j];
+                    check(
+                        effect.ability < ABILITY_COUNT && effect.value != 0 && (j == 0 || instance.effects[j - 1].ability < effect.ability),
+                        "inventory {} is corrupt at charm {}", path, i
+                    );
+                }
             }
+
+            return res;
         }
     } // namespace
 
@@ -137,8 +325,12 @@ namespace mtce
         cli_options args;
         args.algo = naive_algo_flags{
             .threads = std::thread::hardware_concurrency(),
+            .best_first_limit = BEST_FIRST_LIMIT,
         };
 
+        bool explicit_threads = false;
+        bool explicit_kernel = false;
+
         std::string_view prog_name = argv[0];
 
         for (int i = 1; i < argc; i++)
@@ -172,7 +364,7 @@ namespace mtce
             else if (arg.starts_with(CLI_WEIGHT_PREFIX))
             {
                 auto name = std::string(arg.substr(CLI_WEIGHT_PREFIX.size()));
-                check(NAME_TO_ID.contains(name), "unknown effect type");
+                check(find_effect(name).has_value(), "unknown effect type");
                 args.config.ability_weights[name] = parse_arg_typed<int32_t>(arg, i, argc, argv);
             }
             else if (arg == "--in" || arg == "-i")
@@ -187,6 +379,22 @@ namespace mtce
             {
                 args.bot_mode = true;
             }
+            else if (arg == "--estimate")
+            {
+                args.estimate = true;
+            }
+            else if (arg == "--autotune")
+            {
+                args.autotune_file = parse_arg_generic(arg, i, argc, argv);
+            }
+            else if (arg == "--merge")
+            {
+                args.merge_files.push_back(parse_arg_generic(arg, i, argc, argv));
+            }
+            else if (arg == "--compile-inventory")
+            {
+                args.compiled_inventory_file = parse_arg_generic(arg, i, argc, argv);
+            }
             else if (arg == "--algo")
             {
                 auto algo_name = parse_arg_generic(arg, i, argc, argv);
@@ -194,6 +402,14 @@ namespace mtce
                 {
                     args.algo = naive_algo_flags{
                         .threads = std::thread::hardware_concurrency(),
+                        .best_first_limit = BEST_FIRST_LIMIT,
+                    };
+                }
+                else if (algo_name == "portfolio")
+                {
+                    args.algo = portfolio_algo_flags{
+                        .threads = std::thread::hardware_concurrency(),
+                        .best_first_limit = BEST_FIRST_LIMIT,
                     };
                 }
                 else
@@ -201,13 +417,117 @@ namespace mtce
                     check(false, "unknown charm evaluation algorithm: {}", algo_name);
                 }
             }
-            else if (arg == "--naive-threads" && std::holds_alternative<naive_algo_flags>(args.algo))
+            else if (arg == "--naive-threads")
+            {
+                auto threads = parse_arg_typed<uint16_t>(arg, i, argc, argv);
+                std::visit([threads](auto& flags) { flags.threads = threads; }, args.algo);
+                explicit_threads = true;
+            }
+            else if (arg == "--naive-trace")
+            {
+                std::visit([](auto& flags) { flags.enable_trace = true; }, args.algo);
+            }
+            else if (arg == "--naive-bound" && std::holds_alternative<naive_algo_flags>(args.algo))
+            {
+                std::get<naive_algo_flags>(args.algo).prune_bound = true;
+            }
+            else if (arg == "--naive-int16")
+            {
+                std::visit([](auto& flags) { flags.narrow_stats = true; }, args.algo);
+            }
+            else if (arg == "--naive-coarse" && std::holds_alternative<naive_algo_flags>(args.algo))
+            {
+                std::get<naive_algo_flags>(args.algo).coarse = true;
+            }
+            else if (arg == "--naive-best-first" && std::holds_alternative<naive_algo_flags>(args.algo))
+            {
+                std::get<naive_algo_flags>(args.algo).best_first = true;
+            }
+            else if (arg == "--naive-queue-limit")
+            {
+                auto limit = parse_arg_typed<std::size_t>(arg, i, argc, argv);
+                std::visit([limit](auto& flags) { flags.best_first_limit = limit; }, args.algo);
+            }
+            else if (arg == "--naive-walk")
+            {
+                auto mode = parse_arg_generic(arg, i, argc, argv);
+                auto& walk = std::visit([](auto& flags) -> naive_walk& { return flags.walk; }, args.algo);
+
+                if (mode == "auto")
+                {
+                    walk = naive_walk::automatic;
+                }
+                else if (mode == "recursive")
+                {
+                    walk = naive_walk::recursive;
+                }
+                else if (mode == "in-place")
+                {
+                    walk = naive_walk::in_place;
+                }
+                else if (mode == "sparse")
+                {
+                    walk = naive_walk::sparse;
+                }
+                else if (mode == "tiled")
+                {
+                    walk = naive_walk::tiled;
+                }
+                else
+                {
+                    check(false, "unknown walk: {}", mode);
+                }
+            }
+            else if (arg == "--shard" && std::holds_alternative<naive_algo_flags>(args.algo))
+            {
+                auto value = parse_arg_generic(arg, i, argc, argv);
+                auto parts = split_string_view(value, '/');
+                check(parts.size() == 2, "--shard must be followed by i/n");
+
+                eval_shard shard;
+                auto [index_end, index_ec] = std::from_chars(parts[0].data(), parts[0].data() + parts[0].size(), shard.index);
+                auto [count_end, count_ec] = std::from_chars(parts[1].data(), parts[1].data() + parts[1].size(), shard.count);
+                check(
+                    index_ec == std::errc{} && count_ec == std::errc{} && index_end == parts[0].data() + parts[0].size() &&
+                        count_end == parts[1].data() + parts[1].size(),
+                    "failed to parse shard {}", value
+                );
+                check(shard.count > 0 && shard.index < shard.count, "shard index must be less than the shard count");
+
+                std::get<naive_algo_flags>(args.algo).shard = shard;
+            }
+            else if (arg == "--pin" && std::holds_alternative<naive_algo_flags>(args.algo))
+            {
+                auto mode = parse_arg_generic(arg, i, argc, argv);
+                auto& pin = std::get<naive_algo_flags>(args.algo).pin;
+
+                if (mode == "none")
+                {
+                    pin = sched::pin_mode::none;
+                }
+                else if (mode == "cores")
+                {
+                    pin = sched::pin_mode::cores;
+                }
+                else if (mode == "numa")
+                {
+                    pin = sched::pin_mode::numa;
+                }
+                else
+                {
+                    check(false, "unknown pin mode: {}", mode);
+                }
+            }
+            else if (arg == "--naive-kernel")
             {
-                std::get<naive_algo_flags>(args.algo).threads = parse_arg_typed<uint16_t>(arg, i, argc, argv);
+                auto name = parse_arg_generic(arg, i, argc, argv);
+                check(set_naive_kernel(name), "kernel {} is unknown or not supported by this cpu", name);
+                explicit_kernel = true;
             }
-            else if (arg == "--naive-trace" && std::holds_alternative<naive_algo_flags>(args.algo))
+            else if (arg == "--naive-profile")
             {
-                std::get<naive_algo_flags>(args.algo).enable_trace = true;
+                auto profile = read_profile(std::string(parse_arg_generic(arg, i, argc, argv)));
+                std::visit([&profile](auto& flags) { flags.profile = profile; }, args.algo);
             }
             else
             {
@@ -215,13 +535,33 @@ namespace mtce
             }
         }
 
-        check(!args.charm_input_file.empty(), "missing --in (charm input file), try --help?");
+        // with a profile, let the evaluator pick the thread count, and the kernel among the ones it measured unless one was forced
+        std::visit(
+            [explicit_threads, explicit_kernel](auto& flags) {
+                if (!flags.profile.entries.empty() && !explicit_threads)
+                {
+                    flags.threads = 0;
+                }
+
+                if (explicit_kernel)
+                {
+                    std::erase_if(flags.profile.entries, [](const auto& model) {
+                        return !model.kernel.empty() && model.kernel != naive_kernel_name();
+                    });
+                }
+            },
+            args.algo
+        );
+
+        check(!args.charm_input_file.empty() || !args.autotune_file.empty(), "missing --in (charm input file), try --help?");
         return args;
     }
 
     void read_config(const std::string& path, config& out)
     {
-        std::ifstream ifs(path);
+        const mapped_file file(path);
+        check(file.is_open(), "failed to open config {}", path);
+        const auto text = file.view();
 
         enum : uint8_t
         {
@@ -229,14 +569,16 @@ namespace mtce
             WEIGHTS
         } section = GLOBAL;
 
-        std::string raw_line;
-
         size_t line_no = 0;
 
-        while (std::getline(ifs, raw_line))
+        for (size_t pos = 0; pos < text.size();)
         {
+            const auto line_end = find_first_of<'\n'>(text, pos);
+            const auto raw_line = text.substr(pos, line_end - pos);
+            pos = line_end + 1;
+
             line_no++;
-            auto line = trim(std::string_view(raw_line).substr(0, raw_line.find('#')));
+            auto line = trim(raw_line.substr(0, raw_line.find('#')));
 
             if (line.empty())
             {
@@ -279,8 +621,7 @@ namespace mtce
                     break;
                 }
                 case WEIGHTS: {
-                    auto iter = mtce::NAME_TO_ID.find(key);
-                    check(iter != mtce::NAME_TO_ID.end(), "unknown charm effect on line {}: '{}'", line_no, key);
+                    check(find_effect(key).has_value(), "unknown charm effect on line {}: '{}'", line_no, key);
                     out.ability_weights[std::string(key)] = read_cfg_int(line_no, value);
                 }
                 break;
@@ -289,60 +630,337 @@ namespace mtce
         }
     }
 
+    auto read_profile(const std::string& path) -> naive_profile
+    {
+        std::ifstream ifs(path);
+        check(ifs.good(), "failed to open profile {}", path);
+
+        naive_profile profile;
+        std::string raw_line;
+        size_t line_no = 0;
+
+        while (std::getline(ifs, raw_line))
+        {
+            line_no++;
+            auto line = trim(std::string_view(raw_line).substr(0, raw_line.find('#')));
+
+            if (line.empty())
+            {
+                continue;
+            }
+
+            auto parts = split_string_view(line, ' ');
+            // profiles from before per-kernel tuning have no kernel column, and apply to the active kernel
+            check(
+                parts.size() == 4 || parts.size() == 5, "malformed profile on line {}: expected 'threads node_ns lane_ns thread_spawn_ns [kernel]'",
+                line_no
+            );
+
+            auto read_value = [&]<typename T>(std::string_view value, T& out) {
+                auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+                check(ptr == value.data() + value.size() && ec == std::errc{}, "malformed profile on line {}: failed to parse '{}'", line_no, value);
+            };
+
+            naive_cost_model model;
+            read_value(parts[0], model.threads);
+            read_value(parts[1], model.node_ns);
+            read_value(parts[2], model.lane_ns);
+            read_value(parts[3], model.thread_spawn_ns);
+            if (parts.size() == 5)
+            {
+                model.kernel = parts[4];
+            }
+            check(model.threads > 0, "malformed profile on line {}: thread count must be positive", line_no);
+            profile.entries.push_back(model);
+        }
+
+        return profile;
+    }
+
+    void write_profile(const std::string& path, const naive_profile& profile)
+    {
+        std::ofstream ofs(path);
+        check(ofs.good(), "failed to open profile {} for writing", path);
+
+        std::println(ofs, "# mtce naive profile, written by --autotune");
+        std::println(ofs, "# threads node_ns lane_ns thread_spawn_ns kernel");
+        for (const auto& model : profile.entries)
+        {
+            std::println(ofs, "{} {} {} {} {}", model.threads, model.node_ns, model.lane_ns, model.thread_spawn_ns, model.kernel);
+        }
+    }
+
+    void write_inventory(const std::string& path, const std::vector<charm>& charms)
+    {
+        std::vector<inventory_effect> effects;
+        std::vector<inventory_charm> entries;
+        std::string names;
+        entries.reserve(charms.size());
+
+        for (const auto& charm : charms)
+        {
+            // read_inventory rejects anything else
+            check(charm.charm_power <= CHARM_POWER_MAX, "charm {} has cp {}, more than {}", charm.name, charm.charm_power, CHARM_POWER_MAX);
+
+            entries.push_back({
+                .charm_power = charm.charm_power,
+                .color = charm.color,
+                .first_effect = (uint32_t)effects.size(),
+                .effect_count = (uint32_t)charm.effects.size(),
+                .name_offset = (uint32_t)names.size(),
+                .name_size = (uint32_t)charm.name.size(),
+                .has_upgrade = charm.has_upgrade ? 1U : 0U,
+                .reserved = 0,
+            });
+
+            for (const auto& [ability, value] : charm.effects)
+            {
+                effects.push_back({.ability = ability, .reserved = {}, .value = value});
+            }
+
+            names += charm.name;
+        }
+
+        const inventory_header header{
+            .magic = INVENTORY_MAGIC,
+            .version = INVENTORY_VERSION,
+            .charm_count = (uint32_t)entries.size(),
+            .schema = inventory_schema(),
+            .effect_count = (uint32_t)effects.size(),
+            .names_size = (uint32_t)names.size(),
+        };
+
+        std::ofstream ofs(path, std::ios::binary);
+        check(ofs.good(), "failed to open inventory {} for writing", path);
+
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(effects.data()), (std::streamsize)(effects.size() * sizeof(inventory_effect)));
+        ofs.write(reinterpret_cast<const char*>(entries.data()), (std::streamsize)(entries.size() * sizeof(inventory_charm)));
+        ofs.write(names.data(), (std::streamsize)names.size());
+        check(ofs.good(), "failed to write inventory {}", path);
+    }
+
     // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
-    auto read_charms(const std::string& path) -> std::vector<charm>
+    auto inventory_fingerprint(const std::vector<charm>& charms, const config& config) -> uint64_t
     {
-        constexpr static std::array COLOR_BY_RARITY = {0x9f929cU, 0x70bc6dU, 0x705ecaU, 0xcd5ecaU, 0xe49b20U};
+        // fnv-1a
+        uint64_t hash = 0xcbf29ce484222325;
+        auto mix = [&](uint64_t value) {
+            for (size_t i = 0; i < sizeof(value); i++)
+            {
+                hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 0x100000001b3;
+            }
+        };
 
-        std::vector<charm> res;
-        std::ifstream ifs(path);
+        mix(config.max_cp);
+        for (const auto weight : config.to_weights())
+        {
+            mix((uint32_t)weight);
+        }
+
+        mix(charms.size());
+        for (const auto& charm : charms)
+        {
+            mix(charm.charm_power);
+            mix(charm.has_upgrade ? 1 : 0);
+            for (const auto value : charm.dense_effects())
+            {
+                mix(std::bit_cast<uint64_t>(value));
+            }
+        }
+
+        return hash;
+    }
+
+    void write_shard_result(std::ostream& out, const shard_result& result)
+    {
+        std::println(out, "# mtce shard result, written by --shard and read by --merge");
+        std::println(out, "shard {}/{}", result.shard.index, result.shard.count);
+        std::println(out, "inventory {:016x}", result.inventory);
+        std::println(out, "utility {}", result.result.utility_value);
+
+        std::string charms = "charms";
+        for (const auto charm : result.result.charms)
+        {
+            charms += std::format(" {}", charm);
+        }
+        std::println(out, "{}", charms);
+    }
 
-        std::string curr_line;
+    auto read_shard_result(const std::string& path) -> shard_result
+    {
+        std::ifstream ifs(path);
+        check(ifs.good(), "failed to open shard result {}", path);
 
+        shard_result result{};
+        std::string raw_line;
         size_t line_no = 0;
+        bool has_shard = false;
+        bool has_inventory = false;
+        bool has_utility = false;
+
+        auto read_value = [&]<typename T>(std::string_view value, T& out, int base = 10) {
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), out, base);
+            check(ptr == value.data() + value.size() && ec == std::errc{}, "malformed shard result {} on line {}: failed to parse '{}'", path, line_no, value);
+        };
 
-        while (std::getline(ifs, curr_line))
+        while (std::getline(ifs, raw_line))
         {
             line_no++;
-            const auto parts = split_string_view(curr_line, ';');
+            auto line = trim(std::string_view(raw_line).substr(0, raw_line.find('#')));
 
-            if (parts.size() != 5 && parts.size() != 6)
+            if (line.empty())
             {
-                std::println(std::cerr, "bad charm data on line {}", line_no);
-                std::exit(-1);
+                continue;
+            }
+
+            auto parts = split_string_view(line, ' ');
+            if (parts[0] == "shard" && parts.size() == 2)
+            {
+                auto shard = split_string_view(parts[1], '/');
+                check(shard.size() == 2, "malformed shard result {} on line {}: expected 'shard i/n'", path, line_no);
+                read_value(shard[0], result.shard.index);
+                read_value(shard[1], result.shard.count);
+                has_shard = true;
+            }
+            else if (parts[0] == "inventory" && parts.size() == 2)
+            {
+                read_value(parts[1], result.inventory, 16);
+                has_inventory = true;
+            }
+            else if (parts[0] == "utility" && parts.size() == 2)
+            {
+                read_value(parts[1], result.result.utility_value);
+                has_utility = true;
+            }
+            else if (parts[0] == "charms")
+            {
+                for (const auto part : std::span(parts).subspan(1))
+                {
+                    read_value(part, result.result.charms.emplace_back());
+                }
+            }
+            else
+            {
+                check(false, "malformed shard result {} on line {}: '{}'", path, line_no, line);
+            }
+        }
+
+        check(has_shard && has_inventory && has_utility, "incomplete shard result {}", path);
+        return result;
+    }
+
+    auto merge_shard_results(const std::vector<shard_result>& shards) -> eval_result
+    {
+        check(!shards.empty(), "nothing to merge");
+
+        const auto count = shards.front().shard.count;
+        std::vector<bool> seen(count);
+
+        for (const auto& shard : shards)
+        {
+            check(shard.shard.count == count, "shard results are from runs with different shard counts ({} and {})", count, shard.shard.count);
+            check(shard.inventory == shards.front().inventory, "shard results are from runs with different charms or configs");
+            check(shard.shard.index < count && !seen[shard.shard.index], "shard {}/{} is given more than once", shard.shard.index, count);
+            seen[shard.shard.index] = true;
+        }
+
+        auto missing = std::ranges::find(seen, false);
+        check(missing == seen.end(), "shard {}/{} is missing", missing - seen.begin(), count);
+
+        // ties go to the smallest set, so the result doesn't depend on the order of the files
+        const auto* best = &shards.front().result;
+        for (const auto& shard : shards)
+        {
+            const auto& result = shard.result;
+            if (result.utility_value > best->utility_value || (result.utility_value == best->utility_value && result.charms < best->charms))
+            {
+                best = &result;
             }
+        }
+
+        return *best;
+    }
+
+    auto read_charms(const std::string& path) -> std::vector<charm>
+    {
+        constexpr static std::array COLOR_BY_RARITY = {0x9f929cU, 0x70bc6dU, 0x705ecaU, 0xcd5ecaU, 0xe49b20U};
+
+        const mapped_file file(path);
+        check(file.is_open(), "failed to open charm data {}", path);
+
+        if (file.view().starts_with(std::string_view(INVENTORY_MAGIC.data(), INVENTORY_MAGIC.size())))
+        {
+            return read_inventory(file.view(), path);
+        }
+
+        std::vector<charm> res;
+        std::vector<size_t> effect_ids; // reused by every line
+        charm_tokenizer tokens(file.view());
 
-            if (curr_line.empty())
+        size_t line_no = 0;
+
+        // rarity;name;cp;effect:...;value:...[;upgraded value:...]
+        while (!tokens.done())
+        {
+            line_no++;
+
+            const auto rarity_field = tokens.next_field();
+            if (rarity_field.text.empty() && rarity_field.end == '\n')
             {
                 continue;
             }
 
-            auto rarity = read_charm_val<uint8_t>(line_no, parts[0]);
+            check(rarity_field.end == ';', "bad charm data on line {}", line_no);
+            auto rarity = read_charm_val<uint8_t>(line_no, rarity_field.text);
 
             check(rarity < COLOR_BY_RARITY.size(), "bad charm data on line {}: illegal rarity {}", line_no, rarity);
 
-            auto name = parts[1];
-            auto charm_power = read_charm_val<uint8_t>(line_no, parts[2]);
-            auto effect_names = split_string_view(parts[3], ':');
+            const auto name = tokens.next_field();
+            check(name.end == ';', "bad charm data on line {}", line_no);
+            const auto charm_power_field = tokens.next_field();
+            check(charm_power_field.end == ';', "bad charm data on line {}", line_no);
+            auto charm_power = read_charm_val<uint8_t>(line_no, charm_power_field.text);
 
-            std::vector<size_t> effect_ids;
-            effect_ids.reserve(effect_names.size());
-            for (const auto effect : effect_names)
+            effect_ids.clear();
+            charm_tokenizer::token effect{.text = {}, .end = ':'};
+            while (effect.end == ':')
             {
-                const auto iter = NAME_TO_ID.find(effect);
-                check(iter != NAME_TO_ID.end(), "bad charm data on line {}: unknown effect {}", line_no, effect);
-                effect_ids.push_back(iter->second);
+                effect = tokens.next();
+                const auto id = find_effect(effect.text);
+                check(id.has_value(), "bad charm data on line {}: unknown effect {}", line_no, effect.text);
+                effect_ids.push_back(*id);
             }
 
-            res.push_back(create_charm(charm_power, COLOR_BY_RARITY.at(rarity), std::string(name), parts.size() == 6, effect_ids, parts[4], line_no));
+            check(effect.end == ';', "bad charm data on line {}", line_no);
+
+            charm instance{
+                .charm_power = charm_power,
+                .color = COLOR_BY_RARITY.at(rarity),
+                .name = std::string(name.text),
+                .has_upgrade = false,
+            };
 
-            if (parts.size() == 6)
+            if (read_effect_values(tokens, effect_ids, instance, line_no) == '\n')
             {
-                check(rarity < COLOR_BY_RARITY.size() - 1, "bad charm data on line {}: illegal rarity {}", line_no, rarity);
-                res.push_back(
-                    create_charm(charm_power, COLOR_BY_RARITY.at(rarity + 1), std::string(name) + " (u)", false, effect_ids, parts[5], line_no)
-                );
+                res.push_back(std::move(instance));
+                continue;
             }
+
+            check(rarity < COLOR_BY_RARITY.size() - 1, "bad charm data on line {}: illegal rarity {}", line_no, rarity);
+
+            charm upgrade{
+                .charm_power = charm_power,
+                .color = COLOR_BY_RARITY.at(rarity + 1),
+                .name = std::string(name.text) + " (u)",
+                .has_upgrade = false,
+            };
+
+            check(read_effect_values(tokens, effect_ids, upgrade, line_no) == '\n', "bad charm data on line {}", line_no);
+
+            instance.has_upgrade = true;
+            res.push_back(std::move(instance));
+            res.push_back(std::move(upgrade));
         }
 
         return res;
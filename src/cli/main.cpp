@@ -17,8 +17,10 @@
 #include <print>
 #include <ratio>
 #include <source_location>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -49,10 +51,9 @@ namespace
 
         for (const auto charm_index : result.charms)
         {
-            const auto& charm = charms[charm_index];
-            for (size_t ability = 0; ability < ABILITY_COUNT; ability++)
+            for (const auto& [ability, value] : charms[charm_index].effects)
             {
-                stats.at(ability) += charm.charm_data.at(ability);
+                stats.at(ability) += value;
             }
         }
         
@@ -134,11 +135,83 @@ namespace
         print_charm_stats(result, charms, config);
     }
 
+    void print_bot_results(const eval_result& result, const std::vector<charm>& charms, const config& config)
+    {
+        std::println(std::cout, "{}", result.utility_value);
+
+        for (auto charm_id : result.charms)
+        {
+            std::println(std::cout, "{}", charm_id);
+        }
+
+        std::println();
+
+        // TODO: add an option to not print ansi escape - currently, we have to strip this in js 
+        print_charm_stats(result, charms, config);
+    }
+
+    struct shard_of
+    {
+        auto operator()(const naive_algo_flags& flags) -> eval_shard { return flags.shard; }
+        auto operator()(const portfolio_algo_flags& /*unused*/) -> eval_shard { return {}; }
+    };
+
     struct algo_info_printer
     {
-        void operator()(naive_algo_flags flags)
+        // a profile leaves the kernel to the evaluator, per input
+        static auto kernel_label(const naive_profile& profile) -> std::string_view
+        {
+            return profile.entries.empty() ? naive_kernel_name() : "profile-selected";
+        }
+
+        void operator()(const naive_algo_flags& flags)
+        {
+            if (flags.threads == 0)
+            {
+                std::println(
+                    std::cout, "MTCE algorithm: " yellow("naive") " with profile-selected worker count, " yellow("{}") " kernel", kernel_label(flags.profile)
+                );
+                return;
+            }
+
+            std::println(
+                std::cout, "MTCE algorithm: " yellow("naive") " with " green("{}") " worker(s), " yellow("{}") " kernel", flags.threads,
+                kernel_label(flags.profile)
+            );
+        }
+
+        void operator()(const portfolio_algo_flags& flags)
+        {
+            if (flags.threads == 0)
+            {
+                std::println(
+                    std::cout, "MTCE algorithm: " yellow("portfolio") " with profile-selected worker count, " yellow("{}") " kernel", kernel_label(flags.profile)
+                );
+                return;
+            }
+
+            std::println(
+                std::cout, "MTCE algorithm: " yellow("portfolio") " with " green("{}") " worker(s), " yellow("{}") " kernel", flags.threads,
+                kernel_label(flags.profile)
+            );
+        }
+    };
+
+    struct algo_estimator
+    {
+        const std::vector<charm>& charms;
+        const config& config;
+
+        // a portfolio runs the same search as naive, only split between strategies
+        auto operator()(const auto& flags) -> eval_estimate
         {
-            std::println(std::cout, "MTCE algorithm: " yellow("naive") " with " green("{}") " worker(s)", flags.threads);
+            return estimate_naive({
+                .charms = charms,
+                .max_cp = config.max_cp,
+                .weights = config.to_weights(),
+                .threads = flags.threads,
+                .profile = flags.profile,
+            });
         }
     };
 
@@ -164,23 +237,89 @@ namespace
             }
         }
 
-        auto operator()(naive_algo_flags flags) -> eval_result
+        static void naive_trace_placement(const sched::cpu_topology& topology, std::span<const sched::cpu_info> workers, sched::pin_mode mode)
+        {
+            std::println(
+                std::cout, gray("placement - {} cpu(s), {} physical core(s), {} numa node(s){}"), topology.cpus.size(), topology.cores, topology.nodes,
+                mode == sched::pin_mode::numa ? ", node-local tables" : ""
+            );
+
+            for (size_t i = 0; i < workers.size(); i++)
+            {
+                const auto& cpu = workers[i];
+                std::println(
+                    std::cout, gray("  - worker {}: cpu {} (core {}, node {}{})"), i, cpu.cpu, cpu.core, cpu.node, cpu.smt_sibling ? ", smt sibling" : ""
+                );
+            }
+        }
+
+        static void naive_trace_encoding(bool narrow, int64_t max_gap)
+        {
+            if (narrow)
+            {
+                std::println(std::cout, gray("encoding - 16-bit stats, the result is at most {} below the optimum"), max_gap);
+                return;
+            }
+
+            std::println(std::cout, gray("encoding - 32-bit stats, an ability gains and loses, loses too much, or has a weight too large for 16 bits"));
+        }
+
+        static void portfolio_trace_engine(std::string_view engine, size_t threads, bool won)
+        {
+            std::println(std::cout, gray("portfolio - {} on {} worker(s){}"), engine, threads, won ? ", proved the result optimal first" : "");
+        }
+
+        static auto naive_trace(bool enable) -> naive_tracing_config
         {
             naive_tracing_config trace;
 
-            if (flags.enable_trace)
+            if (enable)
             {
                 trace.trace_prune = algo_invoker::naive_trace_prune;
+                trace.trace_placement = algo_invoker::naive_trace_placement;
+                trace.trace_encoding = algo_invoker::naive_trace_encoding;
+                trace.trace_engine = algo_invoker::portfolio_trace_engine;
             }
 
+            return trace;
+        }
+
+        auto operator()(const portfolio_algo_flags& flags) -> eval_result
+        {
+            return evaluate_portfolio(
+                {
+                    .charms = charms,
+                    .max_cp = config.max_cp,
+                    .weights = config.to_weights(),
+                    .threads = flags.threads,
+                    .profile = flags.profile,
+                    .narrow_stats = flags.narrow_stats,
+                    .walk = flags.walk,
+                    .best_first_limit = flags.best_first_limit,
+                },
+                naive_trace(flags.enable_trace)
+            );
+        }
+
+        auto operator()(const naive_algo_flags& flags) -> eval_result
+        {
             return evaluate_naive(
                 {
                     .charms = charms,
                     .max_cp = config.max_cp,
                     .weights = config.to_weights(),
                     .threads = flags.threads,
+                    .profile = flags.profile,
+                    .prune_bound = flags.prune_bound,
+                    .pin = flags.pin,
+                    .shard = flags.shard,
+                    .narrow_stats = flags.narrow_stats,
+                    .walk = flags.walk,
+                    .coarse = flags.coarse,
+                    .best_first = flags.best_first,
+                    .best_first_limit = flags.best_first_limit,
                 },
-                trace
+                naive_trace(flags.enable_trace)
             );
         }
     };
@@ -188,10 +327,98 @@ namespace
 
 auto main(int argc, const char* const* argv) -> int
 {
-    auto [config, in, benchmark, algo, bot_mode] = parse_args(argc, argv);
+    auto [config, in, benchmark, algo, bot_mode, estimate, autotune_file, merge_files, compiled_inventory_file] = parse_args(argc, argv);
     auto enable_benchmark = benchmark != 0;
+
+    if (!autotune_file.empty())
+    {
+        std::println(std::cout, "Calibrating MTCE " yellow(VERSION) ", this takes a while...");
+
+        auto profile = autotune_naive({
+            .max_threads = std::max(std::thread::hardware_concurrency(), 1U),
+            .on_measured =
+                [](const naive_cost_model& model) {
+                    std::println(
+                        std::cout,
+                        "  " yellow("{}") ", " green("{}") " worker(s): " green("{:.3f}") " ns/node + " green("{:.3f}") " ns/lane, "
+                        "spawn " green("{:.0f}") " ns",
+                        model.kernel, model.threads, model.node_ns, model.lane_ns, model.thread_spawn_ns
+                    );
+                },
+        });
+
+        write_profile(std::string(autotune_file), profile);
+        std::println(std::cout, "Profile written to {}", autotune_file);
+        return 0;
+    }
+
     auto charms = read_charms(std::string(in));
 
+    if (!compiled_inventory_file.empty())
+    {
+        write_inventory(std::string(compiled_inventory_file), charms);
+        std::println(std::cout, "Inventory of {} charms written to {}", charms.size(), compiled_inventory_file);
+        return 0;
+    }
+
+    if (!merge_files.empty())
+    {
+        std::vector<shard_result> shards;
+        for (const auto file : merge_files)
+        {
+            shards.push_back(read_shard_result(std::string(file)));
+        }
+
+        auto result = merge_shard_results(shards);
+        if (shards.front().inventory != inventory_fingerprint(charms, config))
+        {
+            std::println(std::cerr, "shard results are from a run with different charms or config");
+            return -1;
+        }
+
+        if (bot_mode)
+        {
+            print_bot_results(result, charms, config);
+        }
+        else
+        {
+            print_results(result, charms, config);
+        }
+
+        return 0;
+    }
+
+    if (estimate)
+    {
+        auto result = std::visit(
+            algo_estimator{
+                .charms = charms,
+                .config = config,
+            },
+            algo
+        );
+
+        if (bot_mode)
+        {
+            std::println(std::cout, "{}", result.nodes);
+            std::println(std::cout, "{}", result.seconds);
+            std::println(std::cout, "{}", result.threads);
+        }
+        else
+        {
+            std::println(
+                std::cout, "Search space: " green("{}") " charm sets over " green("{}") " charms and " green("{}") " abilities", result.nodes,
+                result.charms, result.abilities
+            );
+            std::println(
+                std::cout, "Predicted eval time: " green("{:.4f}") " milliseconds with " green("{}") " worker(s), " yellow("{}") " kernel",
+                result.seconds * 1000, result.threads, result.kernel
+            );
+        }
+
+        return 0;
+    }
+
     auto run_profiled = [&]() {
         auto start = std::chrono::high_resolution_clock::now();
 
@@ -208,20 +435,23 @@ auto main(int argc, const char* const* argv) -> int
         return std::make_pair(end - start, result);
     };
 
-    if (bot_mode)
+    if (auto shard = std::visit(shard_of{}, algo); shard.count > 1)
     {
+        // a partial result, only meaningful to --merge
         auto [time, result] = run_profiled();
-        std::println(std::cout, "{}", result.utility_value);
-
-        for (auto charm_id : result.charms)
-        {
-            std::println(std::cout, "{}", charm_id);
-        }
-
-        std::println();
-
-        // TODO: add an option to not print ansi escape - currently, we have to strip this in js 
-        print_charm_stats(result, charms, config);
+        write_shard_result(
+            std::cout,
+            {
+                .shard = shard,
+                .inventory = inventory_fingerprint(charms, config),
+                .result = result,
+            }
+        );
+    }
+    else if (bot_mode)
+    {
+        auto [time, result] = run_profiled();
+        print_bot_results(result, charms, config);
     }
     else if (!enable_benchmark)
     {
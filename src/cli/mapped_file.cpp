@@ -0,0 +1,71 @@
+#include "cli/mapped_file.h"
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <string>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mtce
+{
+    mapped_file::mapped_file(const std::string& path)
+    {
+#ifdef __linux__
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        struct stat info{};
+        const bool regular = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+        if (regular && info.st_size > 0)
+        {
+            void* addr = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                // the parsers read it front to back, once
+                ::madvise(addr, info.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(addr);
+                size = info.st_size;
+                mapped = true;
+            }
+        }
+
+        ::close(fd);
+
+        // mmap can't map an empty file, and there is nothing to read from it either
+        if (mapped || (regular && info.st_size == 0))
+        {
+            opened = true;
+            return;
+        }
+#endif
+
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs)
+        {
+            return;
+        }
+
+        buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+        opened = true;
+    }
+
+    mapped_file::~mapped_file()
+    {
+#ifdef __linux__
+        if (mapped)
+        {
+            ::munmap(const_cast<char*>(data), size);
+        }
+#endif
+    }
+} // namespace mtce
@@ -0,0 +1,152 @@
+#include "common/charm.h"
+#include "common/eval.h"
+#include "common/gen/charm_data.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mtce
+{
+    namespace
+    {
+        inline constexpr size_t SMALL_CHARMS = 6;
+        inline constexpr size_t SMALL_ABILITIES = 4;
+        inline constexpr size_t NARROW_ABILITIES = 8;
+        inline constexpr size_t WIDE_ABILITIES = 32;
+        inline constexpr size_t MAX_CHARMS = 200;
+        inline constexpr size_t EFFECTS_PER_CHARM = 3;
+        inline constexpr uint64_t NODES_PER_THREAD = 4'000'000;
+        inline constexpr size_t REPEATS = 3;
+
+        // a deterministic inventory, so that profiles are comparable between runs and machines
+        auto synthetic_config(size_t charm_count, size_t abilities, size_t threads) -> eval_config
+        {
+            std::minstd_rand rng(charm_count * 31 + abilities);
+            std::uniform_int_distribution<uint32_t> cp_dist(1, 5);
+            std::uniform_int_distribution<size_t> ability_dist(0, abilities - 1);
+            std::uniform_real_distribution<double> value_dist(0.05, 0.3);
+
+            eval_config config{
+                .max_cp = CHARM_POWER_MAX,
+                .weights = {},
+                .threads = threads,
+            };
+
+            for (size_t i = 0; i < abilities; i++)
+            {
+                config.weights.at(i) = 1;
+            }
+
+            config.charms.reserve(charm_count);
+            for (size_t i = 0; i < charm_count; i++)
+            {
+                charm instance{
+                    .charm_power = cp_dist(rng),
+                    .has_upgrade = false,
+                };
+
+                for (size_t j = 0; j < EFFECTS_PER_CHARM; j++)
+                {
+                    auto ability = ability_dist(rng);
+                    instance.set_effect(ability, EFFECT_CAPS.at(ability) * value_dist(rng));
+                }
+
+                config.charms.emplace_back(std::move(instance));
+            }
+
+            return config;
+        }
+
+        // grows the inventory until it is large enough to time reliably
+        auto sized_config(size_t abilities, size_t threads) -> eval_config
+        {
+            for (size_t charm_count = CHARM_COUNT_MAX;; charm_count += CHARM_COUNT_MAX)
+            {
+                auto config = synthetic_config(charm_count, abilities, threads);
+                if (charm_count >= MAX_CHARMS || estimate_naive(config).nodes >= NODES_PER_THREAD * threads)
+                {
+                    return config;
+                }
+            }
+        }
+
+        // best of a few runs on the given kernel, in nanoseconds
+        auto time_eval(eval_config config, std::string_view kernel) -> double
+        {
+            // a profile naming only this kernel makes the evaluator run it, without forcing it on the rest of the process
+            config.profile.entries = {{.threads = config.threads, .kernel = std::string(kernel)}};
+
+            double best = std::numeric_limits<double>::infinity();
+            for (size_t i = 0; i < REPEATS; i++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                evaluate_naive(config);
+                auto end = std::chrono::steady_clock::now();
+                best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+            }
+
+            return best;
+        }
+
+        auto measure(size_t threads, std::string_view kernel) -> naive_cost_model
+        {
+            naive_cost_model model{.threads = threads, .kernel = std::string(kernel)};
+
+            // a tiny inventory is dominated by the fixed cost of the run
+            auto small = synthetic_config(SMALL_CHARMS, SMALL_ABILITIES, threads);
+            model.thread_spawn_ns = threads > 1 ? time_eval(small, kernel) / (double)threads : 0.0;
+
+            // two widths give the per-node and per-lane cost
+            // wall = nodes * cost / threads + spawn * threads, solved for cost
+            auto cpu_per_node = [&](const eval_config& config) {
+                auto estimate = estimate_naive(config);
+                auto wall = time_eval(config, kernel) - (threads > 1 ? model.thread_spawn_ns * (double)threads : 0.0);
+                return std::make_pair(std::max(wall, 0.0) * (double)threads / (double)std::max<uint64_t>(estimate.nodes, 1), estimate.lanes);
+            };
+
+            auto [narrow_cost, narrow_lanes] = cpu_per_node(sized_config(NARROW_ABILITIES, threads));
+            auto [wide_cost, wide_lanes] = cpu_per_node(sized_config(WIDE_ABILITIES, threads));
+
+            model.lane_ns = wide_lanes > narrow_lanes ? std::max((wide_cost - narrow_cost) / (double)(wide_lanes - narrow_lanes), 0.0) : 0.0;
+            model.node_ns = std::max(narrow_cost - model.lane_ns * (double)narrow_lanes, 0.0);
+            return model;
+        }
+    } // namespace
+
+    auto autotune_naive(const autotune_options& options) -> naive_profile
+    {
+        naive_profile profile;
+
+        // powers of two, plus the maximum itself
+        std::vector<size_t> thread_counts;
+        for (size_t threads = 1; threads < options.max_threads; threads *= 2)
+        {
+            thread_counts.push_back(threads);
+        }
+        thread_counts.push_back(std::max<size_t>(options.max_threads, 1));
+
+        // every kernel, since the one dispatched by default isn't always the fastest (the wider vectors can clock the cpu down, and the
+        // generic kernel has less to set up for a handful of lanes), and the evaluator picks between them per input
+        for (const auto kernel : naive_kernels())
+        {
+            for (const auto threads : thread_counts)
+            {
+                auto model = measure(threads, kernel);
+                if (options.on_measured)
+                {
+                    options.on_measured(model);
+                }
+                profile.entries.push_back(model);
+            }
+        }
+
+        return profile;
+    }
+} // namespace mtce
@@ -1,12 +1,21 @@
 #include "common/aligned_eval.h"
 #include "common/charm.h"
 #include "common/eval.h"
+#include "common/eval_task.h"
 #include "common/gen/charm_data.h"
+#include "common/naive_kernel.h"
+#include "common/thread_pool.h"
+#include "common/topology.h"
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <ranges>
 #include <span>
 #include <string_view>
@@ -20,352 +29,707 @@ namespace mtce
 
     namespace
     {
-        using cp_buffer = std::vector<uint32_t>;
+        using kernel::charm_compact_dyn;
+        using kernel::naive_kernel;
 
-        using offset_buffer = std::vector<uint32_t>;
+        // every kernel this cpu can run, best first
+        auto detect_kernels() -> std::vector<const naive_kernel*>
+        {
+            std::vector<const naive_kernel*> kernels;
+
+#ifdef MTCE_X86_KERNELS
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+            {
+                kernels.push_back(&kernel::avx512::KERNEL);
+            }
 
-        using internal_result_t = std::pair<int64_t, charm_set_buffer>;
+            if (__builtin_cpu_supports("avx2"))
+            {
+                kernels.push_back(&kernel::avx2::KERNEL);
+            }
+
+            if (__builtin_cpu_supports("sse4.2"))
+            {
+                kernels.push_back(&kernel::sse42::KERNEL);
+            }
+#endif
 
-        template <std::size_t N>
-        struct eval_config_static
+            kernels.push_back(&kernel::generic::KERNEL);
+            return kernels;
+        }
+
+        auto supported_kernels() -> const std::vector<const naive_kernel*>&
         {
-            const charm_buffer<N>& charms;
-            const cp_buffer& cp_table;
-            const offset_buffer& offset_table;
-            uint32_t max_cp;
-            table_t<N> weights;
-            size_t n_threads;
-        };
+            static const auto kernels = detect_kernels();
+            return kernels;
+        }
 
-        template <std::size_t N>
-        struct charm_eval_helper
+        auto active_kernel() -> std::atomic<const naive_kernel*>&
         {
-            table_t<N> weights;
-            std::span<const table_t<N>> charms;
-            std::span<const uint32_t> cp_table;
-            std::span<const uint32_t> offset_table;
-            uint32_t max_charm_power;
+            static std::atomic<const naive_kernel*> kernel = supported_kernels().front();
+            return kernel;
+        }
 
-            int64_t max_utility_value = -1;
-            charm_set_buffer best_charm_set;
+        struct eval_prep_result
+        {
+            std::vector<size_t> important_abilities;
+            std::vector<charm_compact_dyn> compact_dyn_charms;
+            std::vector<int32_t> compact_weights;
+        };
 
-            charm_eval_helper(const eval_config_static<N>& cfg)
-                : weights(cfg.weights), charms(cfg.charms), cp_table(cfg.cp_table), offset_table(cfg.offset_table), max_charm_power(cfg.max_cp)
+        // pre-processing step for charm data
+        // proportional to the effects the charms have, plus one pass over the abilities
+        auto prepare_charm_data(const std::vector<charm>& charms, const charm_weights& weights) -> eval_prep_result
+        {
+            std::array<bool, ABILITY_COUNT> present{};
+            for (const auto& charm : charms)
             {
+                for (const auto& effect : charm.effects)
+                {
+                    present.at(effect.ability) |= effect.value != 0;
+                }
             }
 
-            [[gnu::always_inline]] constexpr auto eval_stats(const table_t<N>& stats) -> int64_t
+            // ability id -> lane, or no lane for abilities without weight or without any charm affecting them
+            constexpr auto NO_LANE = std::numeric_limits<size_t>::max();
+            std::array<size_t, ABILITY_COUNT> lane_of{};
+            std::vector<size_t> important_abilities;
+
+            for (std::size_t ability_id = 0; ability_id < ABILITY_COUNT; ability_id++)
             {
-                // this gets optimized into really good unrolled vectorized stuff
-                int64_t result = 0;
-                for (std::size_t i = 0; i < N; i++)
+                lane_of.at(ability_id) = NO_LANE;
+                if (weights.at(ability_id) != 0 && present.at(ability_id))
                 {
-                    // bounds check is trivially optimized
-                    result += (int64_t)std::min(stats.stat_table.at(i), ENCODED_CHARM_STAT_SCALE) * weights.stat_table.at(i);
+                    lane_of.at(ability_id) = important_abilities.size();
+                    important_abilities.push_back(ability_id);
                 }
-
-                return result;
             }
 
-            template <int CharmsLeft>
-            [[gnu::always_inline]] constexpr auto eval_charm(const table_t<N>& curr, uint32_t curr_cp, const charm_set_buffer& set, size_t prev_idx)
+            std::vector<charm_compact_dyn> compact_dyn_charms;
+            compact_dyn_charms.reserve(charms.size());
+
+            for (size_t i = 0; i < charms.size(); i++)
             {
-                if (curr_cp > max_charm_power)
-                {
-                    return;
-                }
+                const auto& charm = charms[i];
+                charm_compact_dyn charm_compact;
+                charm_compact.original_index = i;
+                charm_compact.charm_power = charm.charm_power;
+                charm_compact.has_upgrade = charm.has_upgrade;
+                charm_compact.stat_table.resize(important_abilities.size());
+                charm_compact.narrow_table.resize(important_abilities.size());
 
-                // always check utility
-                int64_t utility = eval_stats(curr);
+                bool has_nonzero = false;
 
-                // this branch is really, really, really slow - but we have no way of making it faster :P
-                // even using branchfree is slower! ~0.8 vs ~0.86
-                if (utility > max_utility_value) [[unlikely]]
+                for (const auto& [ability_id, value] : charm.effects)
                 {
-                    max_utility_value = utility;
-                    best_charm_set = set;
+                    const auto lane = lane_of.at(ability_id);
+                    if (lane == NO_LANE || value == 0)
+                    {
+                        continue;
+                    }
+
+                    const auto rel_value = value / EFFECT_CAPS.at(ability_id);
+                    has_nonzero = true;
+                    charm_compact.stat_table[lane] = (int32_t)(rel_value * ENCODED_CHARM_STAT_SCALE);
+                    charm_compact.narrow_table[lane] = (int16_t)std::clamp<long>(
+                        std::lround(rel_value * NARROW_CHARM_STAT_SCALE), std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max()
+                    );
                 }
 
-                if constexpr (CharmsLeft > 0)
+                if (has_nonzero)
                 {
-                    for (size_t i = prev_idx; i < charms.size(); i++)
-                    {
-                        charm_set_buffer new_charm_set = set;
-                        new_charm_set.data[CHARM_COUNT_MAX - CharmsLeft] = i;
-                        table_t<N> new_charm_set_stats = curr;
-                        table_t<N> charm = charms[i];
+                    compact_dyn_charms.emplace_back(std::move(charm_compact));
+                }
+            }
 
-                        for (std::size_t j = 0; j < N; j++)
-                        {
-                            // bounds check is trivially optimized out
-                            new_charm_set_stats.stat_table.at(j) += charm.stat_table.at(j);
-                        }
+            // an upgrade pair is only a pair if both halves survived the filter above, and cost the same - the cp buckets need the table
+            // sorted by cp with the halves of a pair next to each other, so halves that differ are taken as two unrelated charms
+            for (size_t i = 0; i < compact_dyn_charms.size(); i++)
+            {
+                auto& charm = compact_dyn_charms[i];
+                charm.has_upgrade = charm.has_upgrade && i + 1 < compact_dyn_charms.size() &&
+                                    compact_dyn_charms[i + 1].original_index == charm.original_index + 1 &&
+                                    compact_dyn_charms[i + 1].charm_power == charm.charm_power;
+            }
 
-                        eval_charm<CharmsLeft - 1>(new_charm_set_stats, curr_cp + cp_table[i], new_charm_set, i + offset_table[i]);
-                    }
-                }
+            // sort by cp, moving upgrade pairs as a unit so the evaluator can keep skipping them via offset_table
+            std::vector<std::span<charm_compact_dyn>> groups;
+            for (size_t i = 0; i < compact_dyn_charms.size(); i += compact_dyn_charms[i].has_upgrade ? 2 : 1)
+            {
+                groups.emplace_back(compact_dyn_charms.begin() + i, compact_dyn_charms[i].has_upgrade ? 2 : 1);
             }
-        };
 
-        template <std::size_t N>
-        auto eval_charms_serial(const eval_config_static<N>& cfg) -> internal_result_t
-        {
-            charm_eval_helper<N> helper(cfg);
-            table_t<N> stats_buffer{};
+            std::ranges::stable_sort(groups, {}, [](const auto& group) { return group.front().charm_power; });
+
+            std::vector<charm_compact_dyn> sorted_charms;
+            sorted_charms.reserve(compact_dyn_charms.size());
+            for (const auto& group : groups)
+            {
+                std::ranges::move(group, std::back_inserter(sorted_charms));
+            }
 
-            charm_set_buffer id_buffer;
-            helper.template eval_charm<CHARM_COUNT_MAX>(stats_buffer, 0, id_buffer, 0);
-            return {helper.max_utility_value, helper.best_charm_set};
+            compact_dyn_charms = std::move(sorted_charms);
+
+            std::vector<int32_t> compact_weights;
+            compact_weights.reserve(important_abilities.size());
+            for (const auto ability_id : important_abilities)
+            {
+                compact_weights.push_back(weights.at(ability_id));
+            }
+
+            return {
+                .important_abilities = std::move(important_abilities),
+                .compact_dyn_charms = std::move(compact_dyn_charms),
+                .compact_weights = std::move(compact_weights),
+            };
         }
 
-        template <std::size_t N>
-        auto eval_charms_parallel(const eval_config_static<N>& cfg) -> internal_result_t
+        // counts the sets of at most CHARM_COUNT_MAX charms that fit in max_cp, which is the number of nodes the evaluator visits
+        // (saturation pruning can only make this smaller)
+        // ways[k][c] is the number of sets with k charms and exactly c charm power
+        auto count_feasible_sets(const std::vector<charm_compact_dyn>& charms, uint32_t max_cp) -> uint64_t
         {
-            std::vector<charm_eval_helper<N>> results;
-            std::vector<std::thread> workers;
-            std::atomic<charm_id> jobs = 0;
+            // nothing past the total cp of the inventory can make a difference, as in the kernel - and max_cp + 1 can't wrap
+            uint64_t total_cp = 0;
+            for (const auto& charm : charms)
+            {
+                total_cp += charm.charm_power;
+            }
 
-            results.reserve(cfg.n_threads);
-            for (size_t i = 0; i < cfg.n_threads; i++)
+            max_cp = (uint32_t)std::min<uint64_t>(max_cp, total_cp);
+
+            std::array<std::vector<uint64_t>, CHARM_COUNT_MAX + 1> ways;
+            for (auto& row : ways)
             {
-                results.emplace_back(charm_eval_helper<N>(cfg));
+                row.resize((size_t)max_cp + 1);
             }
 
-            for (size_t i = 0; i < cfg.n_threads; i++)
+            ways[0][0] = 1;
+
+            for (size_t i = 0; i < charms.size(); i += charms[i].has_upgrade ? 2 : 1)
             {
-                std::thread worker([&helper = results[i], &jobs, &charms = cfg.charms, &cp_table = cfg.cp_table, &offs = cfg.offset_table]() {
-                    while (true)
-                    {
-                        auto curr_job = jobs.fetch_add(1);
+                // at most one half of an upgrade pair can be taken
+                auto group = std::span(charms).subspan(i, charms[i].has_upgrade ? 2 : 1);
 
-                        if (curr_job >= charms.size())
+                // descending order, so that each group reads the rows from before it was added
+                for (size_t count = CHARM_COUNT_MAX; count > 0; count--)
+                {
+                    for (size_t cp = (size_t)max_cp + 1; cp-- > 0;)
+                    {
+                        for (const auto& charm : group)
                         {
-                            return;
+                            if (charm.charm_power <= cp)
+                            {
+                                ways[count][cp] += ways[count - 1][cp - charm.charm_power];
+                            }
                         }
-
-                        table_t<N> stats_buffer = charms[curr_job];
-                        charm_set_buffer id_buffer;
-                        id_buffer.data[0] = curr_job;
-
-                        helper.template eval_charm<CHARM_COUNT_MAX - 1>(stats_buffer, cp_table[curr_job], id_buffer, curr_job + offs[curr_job]);
                     }
-                });
-                workers.emplace_back(std::move(worker));
+                }
             }
 
-            for (size_t i = 0; i < cfg.n_threads; i++)
+            uint64_t total = 0;
+            for (const auto& row : ways)
             {
-                workers[i].join();
+                for (const auto value : row)
+                {
+                    total += value;
+                }
             }
 
-            int64_t max_utility_value{};
-            charm_set_buffer best_charm_set{};
+            return total;
+        }
+
+        // whether 16-bit saturating stats rank sets the same way as the 32-bit ones, up to rounding
+        // saturating at the cap is only the same as capping at the end if a lane never comes back down from it, so every lane must only
+        // gain or only lose - and a losing lane must never hit the bottom of the range, not even with the bound's most negative values
+        auto narrow_is_exact(const std::vector<charm_compact_dyn>& charms, const std::vector<int32_t>& weights) -> bool
+        {
+            // madd only has room for the sum of two products if no weight is -32768
+            if (std::ranges::any_of(weights, [](int32_t weight) { return weight < -NARROW_CHARM_STAT_SCALE || weight > NARROW_CHARM_STAT_SCALE; }))
+            {
+                return false;
+            }
 
-            for (size_t i = 0; i < cfg.n_threads; i++)
+            for (size_t i = 0; i < weights.size(); i++)
             {
-                if (results[i].max_utility_value > max_utility_value)
+                int32_t lowest = 0;
+                bool gains = false;
+                for (const auto& charm : charms)
                 {
-                    max_utility_value = results[i].max_utility_value;
-                    best_charm_set = results[i].best_charm_set;
+                    lowest = std::min<int32_t>(lowest, charm.narrow_table[i]);
+                    gains |= charm.narrow_table[i] > 0;
+                }
+
+                if (lowest < 0 && (gains || lowest * (int32_t)CHARM_COUNT_MAX < std::numeric_limits<int16_t>::min()))
+                {
+                    return false;
                 }
             }
 
-            return {max_utility_value, best_charm_set};
+            return true;
         }
 
-        template <std::size_t N>
-        auto eval_charms(const eval_config_static<N>& cfg) -> internal_result_t
+        // how far below the optimum the set picked on narrow stats can be, in 32-bit utility
+        // each stat is off by at most half a narrow step plus the truncation of the 32-bit encoding, a lane sums at most CHARM_COUNT_MAX of
+        // them (the cap doesn't add to that), and both the picked set and the optimum can be off in opposite directions
+        auto narrow_error_bound(const std::vector<int32_t>& weights) -> int64_t
         {
-            return cfg.n_threads <= 1 ? eval_charms_serial(cfg) : eval_charms_parallel(cfg);
+            constexpr int64_t STAT_ERROR = (ENCODED_CHARM_STAT_SCALE + 2 * NARROW_CHARM_STAT_SCALE - 1) / (2 * NARROW_CHARM_STAT_SCALE) + 1;
+
+            int64_t total_weight = 0;
+            for (const auto weight : weights)
+            {
+                total_weight += std::abs(weight);
+            }
+
+            return 2 * (int64_t)CHARM_COUNT_MAX * STAT_ERROR * total_weight;
         }
 
-        struct charm_compact_dyn
+        // the 32-bit utility of a set of input charms, which is what a narrow evaluation reports
+        auto exact_utility(const std::vector<charm_compact_dyn>& charms, const std::vector<int32_t>& weights, const std::vector<charm_id>& set)
+            -> int64_t
         {
-            charm_id original_index{};
-            uint32_t charm_power{};
-            bool has_upgrade{};
-            std::vector<int32_t> stat_table;
-        };
+            std::vector<int64_t> stats(weights.size());
+            for (const auto id : set)
+            {
+                const auto& charm = *std::ranges::find(charms, id, &charm_compact_dyn::original_index);
+                for (size_t i = 0; i < weights.size(); i++)
+                {
+                    stats[i] += charm.stat_table[i];
+                }
+            }
 
-        // a bridge between the dynamic "input" space and the specialized "evaluation" space
-        template <std::size_t N>
-        constexpr auto eval_charms_dyn(
-            const std::vector<charm_compact_dyn>& charms, uint32_t max_charm_power, const std::vector<int32_t>& weights, size_t n_threads
-        )
-        {
-            charm_buffer<N> _charms;
-            cp_buffer cp_table;
-            offset_buffer offset_table;
-            table_t<N> _weights{};
+            int64_t utility = 0;
+            for (size_t i = 0; i < weights.size(); i++)
+            {
+                utility += std::min<int64_t>(stats[i], ENCODED_CHARM_STAT_SCALE) * weights[i];
+            }
 
-            _charms.reserve(charms.size());
-            cp_table.reserve(charms.size());
-            offset_table.reserve(charms.size());
+            return utility;
+        }
 
-            for (const auto& charm : charms)
+        // a narrow evaluation for a scheduler, reporting the 32-bit utility of the set it picked
+        class verified_task final : public sched::eval_task
+        {
+            std::unique_ptr<sched::eval_task> inner;
+            std::vector<charm_compact_dyn> charms;
+            std::vector<int32_t> weights;
+
+        public:
+            verified_task(std::unique_ptr<sched::eval_task> inner, std::vector<charm_compact_dyn> charms, std::vector<int32_t> weights)
+                : inner(std::move(inner)), charms(std::move(charms)), weights(std::move(weights))
             {
-                table_t<N> storage{};
-                cp_table.push_back(charm.charm_power);
-                offset_table.push_back(charm.has_upgrade ? 2 : 1);
-                std::copy(charm.stat_table.begin(), charm.stat_table.end(), storage.stat_table.begin());
-                _charms.emplace_back(std::move(storage));
             }
 
-            std::copy(weights.begin(), weights.end(), _weights.stat_table.begin());
+            [[nodiscard]] auto job_count() const -> size_t override { return inner->job_count(); }
 
-            return eval_charms<N>(eval_config_static<N>{
-                .charms = _charms,
-                .cp_table = cp_table,
-                .offset_table = offset_table,
-                .max_cp = max_charm_power,
-                .weights = _weights,
-                .n_threads = n_threads,
-            });
-        }
+            void run_job(size_t job, size_t worker) override { inner->run_job(job, worker); }
 
-        using eval_charm_delegate_t = internal_result_t (*)(
-            const std::vector<charm_compact_dyn>& charms, uint32_t max_charm_power, const std::vector<int32_t>& weights, size_t n_threads
-        );
+            auto finish() -> eval_result override
+            {
+                auto result = inner->finish();
+                result.utility_value = exact_utility(charms, weights, result.charms);
+                return result;
+            }
+        };
 
-        template <std::size_t N>
-        inline constexpr auto TABLE_SIZE_FOR = ((N + TABLE_SIZE_ALIGN - 1) / TABLE_SIZE_ALIGN) * TABLE_SIZE_ALIGN;
+        // the lanes the evaluator for this many abilities actually works on
+        auto padded_lanes(size_t abilities) -> size_t
+        {
+            const auto width = kernel::static_abilities(abilities);
+            return ((width + TABLE_SIZE_ALIGN - 1) / TABLE_SIZE_ALIGN) * TABLE_SIZE_ALIGN;
+        }
 
-        template <typename T>
-        struct _table_helper
+        auto predict_seconds(uint64_t nodes, size_t lanes, size_t threads, const naive_cost_model& model) -> double
         {
-        };
+            // the serial path doesn't spawn anything
+            const auto spawn_ns = threads > 1 ? model.thread_spawn_ns * (double)threads : 0.0;
+            const auto node_ns = model.node_ns + model.lane_ns * (double)lanes;
+            return ((double)nodes * node_ns / (double)threads + spawn_ns) / 1e9;
+        }
 
-        template <std::size_t... Counts>
-        struct _table_helper<std::index_sequence<Counts...>>
+        // the kernel a model was measured with, the active one for models that don't say, or nullptr if this cpu can't run it
+        auto kernel_for(const naive_cost_model& model) -> const naive_kernel*
         {
-            static constexpr eval_charm_delegate_t TABLE[] = {eval_charms_dyn<TABLE_SIZE_FOR<Counts>>...};
-        };
+            if (model.kernel.empty())
+            {
+                return active_kernel().load(std::memory_order_relaxed);
+            }
 
-        using table_helper = _table_helper<std::make_index_sequence<ABILITY_COUNT + 1>>;
+            const auto& kernels = supported_kernels();
+            const auto found = std::ranges::find(kernels, std::string_view(model.kernel), &naive_kernel::name);
+            return found != kernels.end() ? *found : nullptr;
+        }
 
-        struct eval_prep_result
+        struct thread_selection
         {
-            std::vector<size_t> important_abilities;
-            std::vector<charm_compact_dyn> compact_dyn_charms;
-            std::vector<int32_t> compact_weights;
+            size_t threads;
+            double seconds;
+            const naive_kernel* kernel;
         };
 
-        // pre-processing step for charm data
-        auto prepare_charm_data(const std::vector<charm>& charms, const charm_weights& weights) -> eval_prep_result
+        // picks the kernel and thread count with the lowest predicted wall time, or the fastest kernel at the requested thread count (as
+        // predicted by the models measured closest to it)
+        auto select_threads(uint64_t nodes, size_t lanes, size_t requested, const naive_profile& profile) -> thread_selection
         {
-            std::vector<size_t> important_abilities;
-
-            for (std::size_t ability_id = 0; ability_id < ABILITY_COUNT; ability_id++)
+            std::vector<std::pair<naive_cost_model, const naive_kernel*>> candidates;
+            for (const auto& entry : profile.entries)
             {
-                if (weights.at(ability_id) == 0)
+                if (const auto* kernel = kernel_for(entry))
                 {
-                    continue;
+                    candidates.emplace_back(entry, kernel);
                 }
+            }
 
-                bool has_nonzero = false;
-                for (const auto& charm : charms)
+            const auto* active = active_kernel().load(std::memory_order_relaxed);
+            if (candidates.empty())
+            {
+                candidates.emplace_back(naive_cost_model{.threads = 1}, active);
+                candidates.emplace_back(naive_cost_model{.threads = std::max<size_t>(std::thread::hardware_concurrency(), 1)}, active);
+            }
+
+            auto distance = [requested](const auto& candidate) -> size_t {
+                const auto threads = candidate.first.threads;
+                if (requested == 0)
                 {
-                    if (charm.charm_data.at(ability_id) != 0)
-                    {
-                        has_nonzero = true;
-                        break;
-                    }
+                    return 0;
                 }
 
-                if (!has_nonzero)
+                return threads > requested ? threads - requested : requested - threads;
+            };
+            const auto closest = distance(*std::ranges::min_element(candidates, {}, distance));
+
+            thread_selection best{.threads = 1, .seconds = std::numeric_limits<double>::infinity(), .kernel = active};
+            for (const auto& candidate : candidates)
+            {
+                if (distance(candidate) != closest)
                 {
                     continue;
                 }
 
-                important_abilities.push_back(ability_id);
+                const auto& [model, kernel] = candidate;
+
+                auto threads = requested != 0 ? requested : std::max<size_t>(model.threads, 1);
+                auto seconds = predict_seconds(nodes, lanes, threads, model);
+                if (seconds < best.seconds)
+                {
+                    best = {threads, seconds, kernel};
+                }
             }
 
-            std::vector<charm_compact_dyn> compact_dyn_charms;
-            compact_dyn_charms.reserve(charms.size());
+            return best;
+        }
 
-            for (size_t i = 0; i < charms.size(); i++)
+        void trace_inputs(const eval_config& config, const eval_prep_result& prep, const naive_tracing_config& trace)
+        {
+            if (!trace.trace_prune)
             {
-                const auto& charm = charms[i];
-                charm_compact_dyn charm_compact;
-                charm_compact.original_index = i;
-                charm_compact.charm_power = charm.charm_power;
-                charm_compact.has_upgrade = charm.has_upgrade;
-                charm_compact.stat_table.reserve(important_abilities.size());
+                return;
+            }
 
-                bool has_nonzero = false;
+            std::vector<std::string_view> abilities;
+            std::vector<std::string_view> charms;
 
-                for (const auto ability_id : important_abilities)
-                {
-                    const auto rel_value = charm.charm_data.at(ability_id) / EFFECT_CAPS.at(ability_id);
-                    has_nonzero |= (charm.charm_data.at(ability_id) != 0);
-                    charm_compact.stat_table.push_back((int32_t)(rel_value * ENCODED_CHARM_STAT_SCALE));
-                }
+            abilities.reserve(prep.important_abilities.size());
+            charms.reserve(prep.compact_dyn_charms.size());
 
-                if (has_nonzero)
-                {
-                    compact_dyn_charms.emplace_back(std::move(charm_compact));
-                }
+            for (auto important_ability : prep.important_abilities)
+            {
+                abilities.push_back(EFFECT_NAMES.at(important_ability));
             }
 
-            std::vector<int32_t> compact_weights;
-            compact_weights.reserve(important_abilities.size());
-            for (const auto ability_id : important_abilities)
+            for (const auto& important_charm : prep.compact_dyn_charms)
             {
-                compact_weights.push_back(weights.at(ability_id));
+                charms.push_back(config.charms.at(important_charm.original_index).name);
             }
 
-            return {
-                .important_abilities = std::move(important_abilities),
-                .compact_dyn_charms = std::move(compact_dyn_charms),
-                .compact_weights = std::move(compact_weights),
-            };
+            trace.trace_prune(abilities, charms);
         }
-    } // namespace
 
-    auto evaluate_naive(const eval_config& config, const naive_tracing_config& trace) -> eval_result
-    {
-        auto [important_abilities, compact_dyn_charms, compact_weights] = prepare_charm_data(config.charms, config.weights);
+        // the kernel and thread count to run with, picked from the profile - the thread count only unless the config asks for one
+        auto thread_budget(const eval_config& config, const eval_prep_result& prep) -> thread_selection
+        {
+            if (config.threads != 0 && config.profile.entries.empty())
+            {
+                return {.threads = config.threads, .seconds = 0, .kernel = active_kernel().load(std::memory_order_relaxed)};
+            }
+
+            auto nodes = count_feasible_sets(prep.compact_dyn_charms, config.max_cp);
+            return select_threads(nodes, padded_lanes(prep.important_abilities.size()), config.threads, config.profile);
+        }
 
-        if (trace.trace_prune)
+        auto use_narrow(const eval_config& config, const eval_prep_result& prep, const naive_tracing_config& trace) -> bool
         {
-            std::vector<std::string_view> abilities;
-            std::vector<std::string_view> charms;
+            const bool narrow = config.narrow_stats && narrow_is_exact(prep.compact_dyn_charms, prep.compact_weights);
+            if (config.narrow_stats && trace.trace_encoding)
+            {
+                trace.trace_encoding(narrow, narrow ? narrow_error_bound(prep.compact_weights) : 0);
+            }
 
-            abilities.reserve(important_abilities.size());
-            charms.reserve(compact_dyn_charms.size());
+            return narrow;
+        }
+
+        // runs one build of the evaluator, picked by the stat width and the amount of abilities, and reports the set in input order
+        auto run_kernel(const naive_kernel& selected, const eval_prep_result& prep, bool narrow, const kernel::eval_options& options) -> eval_result
+        {
+            const auto& [important_abilities, compact_dyn_charms, compact_weights] = prep;
+            auto [utility, charm_set] =
+                (narrow ? selected.eval_narrow : selected.eval)[important_abilities.size()](compact_dyn_charms, compact_weights, options);
 
-            for (auto important_ability : important_abilities)
+            std::vector<charm_id> original_index;
+            original_index.reserve(compact_dyn_charms.size());
+            for (const auto& charm : compact_dyn_charms)
             {
-                abilities.push_back(EFFECT_NAMES.at(important_ability));
+                original_index.push_back(charm.original_index);
             }
 
-            for (const auto& important_charm : compact_dyn_charms)
+            auto result = kernel::to_eval_result({utility, charm_set}, original_index);
+            if (narrow)
             {
-                charms.push_back(config.charms.at(important_charm.original_index).name);
+                result.utility_value = exact_utility(compact_dyn_charms, compact_weights, result.charms);
             }
 
-            trace.trace_prune(abilities, charms);
+            return result;
         }
 
-        // dynamically select the implementation based on the amount of abilities
-        auto [utility, charm_set] =
-            table_helper::TABLE[important_abilities.size()](compact_dyn_charms, config.max_cp, compact_weights, config.threads);
+        // the coarse pass only beats the exact walk from about this many lanes, and only with vectors, see INTERNALS.md
+        inline constexpr size_t PORTFOLIO_COARSE_LANES = 96;
+
+        // one strategy of evaluate_portfolio, always with the bound
+        struct portfolio_engine
+        {
+            std::string_view name;
+            size_t threads;
+            bool best_first = false;
+            bool coarse = false;
+        };
+
+        // depth-first search gets every thread the others leave, since it is the best choice for most inputs (and picks the sparse or tiled
+        // walk for wide ones by itself)
+        // best-first search wins by far when one ability dominates the weights, and the coarse pass when many abilities are weighed - both
+        // only need one thread to finish first when they do
+        auto pick_engines(size_t threads, size_t lanes, bool narrow, const naive_kernel* selected) -> std::vector<portfolio_engine>
+        {
+            std::vector<portfolio_engine> engines{{.name = "depth-first", .threads = threads}};
+
+            if (threads >= 2)
+            {
+                engines.push_back({.name = "best-first", .threads = 1, .best_first = true});
+            }
+
+            // the coarse pass has no 16-bit build
+            if (threads >= 3 && !narrow && lanes >= PORTFOLIO_COARSE_LANES && selected != &kernel::generic::KERNEL)
+            {
+                engines.push_back({.name = "coarse", .threads = 1, .coarse = true});
+            }
+
+            engines.front().threads -= engines.size() - 1;
+            return engines;
+        }
+    } // namespace
 
-        // translate static result -> dynamic result
+    auto kernel::to_eval_result(const internal_result_t& result, const std::vector<charm_id>& original_index) -> eval_result
+    {
         std::vector<charm_id> ch_res;
         ch_res.reserve(CHARM_COUNT_MAX);
 
-        for (const auto charm : charm_set.data)
+        for (const auto charm : result.second.data)
         {
             if (charm != MISSING_ID)
             {
-                ch_res.push_back(compact_dyn_charms[charm].original_index);
+                ch_res.push_back(original_index[charm]);
             }
         }
 
+        // the evaluator works in cp order, report the set in input order
+        std::ranges::sort(ch_res);
+
         return {
-            .utility_value = utility,
+            .utility_value = result.first,
             .charms = ch_res,
         };
     }
+
+    auto naive_kernels() -> std::vector<std::string_view>
+    {
+        std::vector<std::string_view> names;
+        for (const auto* kernel : supported_kernels())
+        {
+            names.push_back(kernel->name);
+        }
+
+        return names;
+    }
+
+    auto naive_kernel_name() -> std::string_view { return active_kernel().load(std::memory_order_relaxed)->name; }
+
+    auto set_naive_kernel(std::string_view name) -> bool
+    {
+        for (const auto* kernel : supported_kernels())
+        {
+            if (kernel->name == name)
+            {
+                active_kernel().store(kernel, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    auto estimate_naive(const eval_config& config) -> eval_estimate
+    {
+        auto [important_abilities, compact_dyn_charms, compact_weights] = prepare_charm_data(config.charms, config.weights);
+
+        const auto nodes = count_feasible_sets(compact_dyn_charms, config.max_cp);
+        const auto lanes = padded_lanes(important_abilities.size());
+        const auto [threads, seconds, kernel] = select_threads(nodes, lanes, config.threads, config.profile);
+
+        return {
+            .nodes = nodes,
+            .abilities = important_abilities.size(),
+            .lanes = lanes,
+            .charms = compact_dyn_charms.size(),
+            .threads = threads,
+            .seconds = seconds,
+            .kernel = kernel->name,
+        };
+    }
+
+    void set_eval_pool_size(std::size_t threads) { sched::global_pool().resize(threads); }
+
+    auto eval_pool_size() -> std::size_t { return sched::global_pool().size(); }
+
+    auto evaluate_naive(const eval_config& config, const naive_tracing_config& trace) -> eval_result
+    {
+        const auto prep = prepare_charm_data(config.charms, config.weights);
+        trace_inputs(config, prep, trace);
+
+        const auto budget = thread_budget(config, prep);
+        const auto threads = budget.threads;
+
+        // placement only matters once there is more than one worker
+        std::vector<sched::cpu_info> placement;
+        if (config.pin != sched::pin_mode::none && threads > 1)
+        {
+            const auto& topology = sched::system_topology();
+            placement = sched::place_workers(topology, threads);
+
+            if (trace.trace_placement)
+            {
+                trace.trace_placement(topology, placement, config.pin);
+            }
+        }
+
+        // the build of the kernel picked above (by the profile, or for the cpu) for the stat width and the amount of abilities
+        const bool narrow = use_narrow(config, prep, trace);
+        return run_kernel(
+            *budget.kernel, prep, narrow,
+            {
+                .max_cp = config.max_cp,
+                .n_threads = threads,
+                .prune_bound = config.prune_bound,
+                .walk = config.walk,
+                .coarse = config.coarse,
+                .best_first = config.best_first,
+                .best_first_limit = config.best_first_limit,
+                .placement = placement,
+                .replicate = !placement.empty() && config.pin == sched::pin_mode::numa,
+                .shard = config.shard,
+                .race = nullptr,
+            }
+        );
+    }
+
+    auto evaluate_portfolio(const eval_config& config, const naive_tracing_config& trace) -> eval_result
+    {
+        const auto prep = prepare_charm_data(config.charms, config.weights);
+        trace_inputs(config, prep, trace);
+
+        // with one thread to spare (which is what the profile picks for small inputs) there is nothing to race
+        const bool narrow = use_narrow(config, prep, trace);
+        const auto budget = thread_budget(config, prep);
+        const auto* selected = budget.kernel;
+        const auto engines = pick_engines(budget.threads, padded_lanes(prep.important_abilities.size()), narrow, selected);
+
+        sched::eval_race race;
+        std::optional<eval_result> result;
+        size_t winner = 0;
+
+        auto run_engine = [&](size_t i) {
+            const auto& engine = engines[i];
+            auto engine_result = run_kernel(
+                *selected, prep, narrow,
+                {
+                    .max_cp = config.max_cp,
+                    .n_threads = engine.threads,
+                    .prune_bound = true,
+                    .walk = config.walk,
+                    .coarse = engine.coarse,
+                    .best_first = engine.best_first,
+                    .best_first_limit = config.best_first_limit,
+                    .placement = {},
+                    .replicate = false,
+                    .shard = {},
+                    .race = &race,
+                }
+            );
+
+            // an engine that was stopped returns after stop is set, so the first one to set it searched everything it had to
+            if (!race.stop.exchange(true))
+            {
+                winner = i;
+                result = std::move(engine_result);
+            }
+        };
+
+        // one pool worker per engine, the first one on this thread - a parallel engine then runs a batch of its own on the pool, which
+        // grows to the threads the engines were given once, and reuses them from then on
+        sched::global_pool().run(engines.size(), run_engine);
+
+        if (trace.trace_engine)
+        {
+            for (size_t i = 0; i < engines.size(); i++)
+            {
+                trace.trace_engine(engines[i].name, engines[i].threads, i == winner);
+            }
+        }
+
+        return *std::move(result);
+    }
+
+    auto make_naive_task(const eval_config& config, std::size_t workers) -> std::unique_ptr<sched::eval_task>
+    {
+        auto [important_abilities, compact_dyn_charms, compact_weights] = prepare_charm_data(config.charms, config.weights);
+
+        const bool narrow = config.narrow_stats && narrow_is_exact(compact_dyn_charms, compact_weights);
+        const auto* selected = active_kernel().load(std::memory_order_relaxed);
+
+        auto task = (narrow ? selected->make_task_narrow : selected->make_task)[important_abilities.size()](
+            compact_dyn_charms, compact_weights,
+            {
+                .max_cp = config.max_cp,
+                .n_threads = workers,
+                .prune_bound = config.prune_bound,
+                .walk = config.walk,
+                .coarse = config.coarse,
+                .best_first = config.best_first,
+                .best_first_limit = config.best_first_limit,
+                .placement = {},
+                .replicate = false,
+                .shard = {},
+                .race = nullptr,
+            },
+            workers
+        );
+
+        if (narrow)
+        {
+            return std::make_unique<verified_task>(std::move(task), std::move(compact_dyn_charms), std::move(compact_weights));
+        }
+
+        return task;
+    }
 } // namespace mtce
@@ -0,0 +1,232 @@
+#include "common/eval_scheduler.h"
+#include "common/eval.h"
+#include "common/eval_task.h"
+#include "common/thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mtce
+{
+    namespace
+    {
+        struct pending_eval
+        {
+            std::unique_ptr<sched::eval_task> task;
+            std::promise<eval_result> promise;
+            size_t next_job = 0;
+            size_t remaining = 0;
+        };
+
+        struct requester_state
+        {
+            uint32_t share = 1;
+            double used = 0.0; // worker time in ns, divided by the share
+            size_t cursor = 0;
+            size_t running = 0;                                  // jobs handed out that haven't finished
+            std::vector<std::shared_ptr<pending_eval>> runnable; // evaluations with jobs left to hand out
+        };
+    } // namespace
+
+    struct eval_scheduler::state
+    {
+        std::size_t workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::unordered_map<requester_id, requester_state> requesters;
+        size_t running = 0; // jobs handed out that haven't finished, over every requester
+        bool stopping = false;
+        std::thread dispatcher;
+
+        explicit state(std::size_t workers) : workers(workers) {}
+
+        // the requester with the least share-weighted usage among those with jobs left
+        auto next_requester() -> std::pair<requester_id, requester_state*>
+        {
+            std::pair<requester_id, requester_state*> best{0, nullptr};
+            for (auto& [id, requester] : requesters)
+            {
+                if (!requester.runnable.empty() && (best.second == nullptr || requester.used < best.second->used))
+                {
+                    best = {id, &requester};
+                }
+            }
+
+            return best;
+        }
+
+        // a requester with nothing queued or running and the default share has nothing worth keeping, so a long-lived host doesn't
+        // collect one entry per requester it ever saw
+        void release_if_idle(requester_id id)
+        {
+            auto found = requesters.find(id);
+            if (found != requesters.end() && found->second.runnable.empty() && found->second.running == 0 && found->second.share == 1)
+            {
+                requesters.erase(found);
+            }
+        }
+
+        // one worker of a pool batch: runs jobs until none are queued, and none are running that could be followed by more - a job
+        // submitted while another one runs is still picked up without waiting for the next batch
+        void worker_main(size_t worker)
+        {
+            std::unique_lock lock(mutex);
+
+            while (true)
+            {
+                std::pair<requester_id, requester_state*> next{0, nullptr};
+                wake.wait(lock, [&] {
+                    next = next_requester();
+                    return stopping || next.second != nullptr || running == 0;
+                });
+
+                auto [id, requester] = next;
+                if (stopping || requester == nullptr)
+                {
+                    return;
+                }
+
+                // round-robin over the requester's own evaluations, so that its small ones don't queue behind its large ones either
+                requester->cursor %= requester->runnable.size();
+                auto eval = requester->runnable[requester->cursor++];
+                auto job = eval->next_job++;
+
+                if (eval->next_job == eval->task->job_count())
+                {
+                    std::erase(requester->runnable, eval);
+                }
+
+                requester->running++;
+                running++;
+
+                lock.unlock();
+                auto start = std::chrono::steady_clock::now();
+                eval->task->run_job(job, worker);
+                auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                lock.lock();
+
+                // a requester isn't released while it has jobs running, so this is still valid
+                requester->used += elapsed / requester->share;
+                requester->running--;
+                release_if_idle(id);
+
+                if (--running == 0)
+                {
+                    wake.notify_all();
+                }
+
+                if (--eval->remaining == 0)
+                {
+                    lock.unlock();
+                    eval->promise.set_value(eval->task->finish());
+                    lock.lock();
+                }
+            }
+        }
+
+        // starts a batch on the pool whenever jobs are queued, and takes part in it as worker 0
+        void dispatcher_main()
+        {
+            const std::function<void(size_t)> run_worker = [this](size_t worker) { worker_main(worker); };
+
+            while (true)
+            {
+                {
+                    std::unique_lock lock(mutex);
+                    wake.wait(lock, [&] { return stopping || next_requester().second != nullptr; });
+                    if (stopping)
+                    {
+                        return;
+                    }
+                }
+
+                sched::global_pool().run(workers, run_worker);
+            }
+        }
+    };
+
+    eval_scheduler::eval_scheduler(std::size_t threads) : impl(std::make_unique<state>(std::max<size_t>(threads, 1)))
+    {
+        impl->dispatcher = std::thread([state = impl.get()] { state->dispatcher_main(); });
+    }
+
+    eval_scheduler::~eval_scheduler()
+    {
+        {
+            std::lock_guard lock(impl->mutex);
+            impl->stopping = true;
+        }
+
+        impl->wake.notify_all();
+        impl->dispatcher.join();
+    }
+
+    void eval_scheduler::set_share(requester_id requester, std::uint32_t share)
+    {
+        std::lock_guard lock(impl->mutex);
+        impl->requesters[requester].share = std::max<uint32_t>(share, 1);
+        impl->release_if_idle(requester);
+    }
+
+    auto eval_scheduler::submit(requester_id requester, const eval_config& config) -> std::future<eval_result>
+    {
+        auto eval = std::make_shared<pending_eval>();
+        eval->task = make_naive_task(config, impl->workers);
+        eval->remaining = eval->task->job_count();
+        auto result = eval->promise.get_future();
+
+        // everything was above the split depth
+        if (eval->remaining == 0)
+        {
+            eval->promise.set_value(eval->task->finish());
+            return result;
+        }
+
+        {
+            std::lock_guard lock(impl->mutex);
+            auto& state = impl->requesters[requester];
+
+            // an idle requester doesn't bank credit: it rejoins at the usage of the least served busy requester
+            if (state.runnable.empty())
+            {
+                auto floor = std::numeric_limits<double>::infinity();
+                for (const auto& [id, other] : impl->requesters)
+                {
+                    if (!other.runnable.empty())
+                    {
+                        floor = std::min(floor, other.used);
+                    }
+                }
+
+                if (floor != std::numeric_limits<double>::infinity())
+                {
+                    state.used = std::max(state.used, floor);
+                }
+            }
+
+            state.runnable.push_back(std::move(eval));
+        }
+
+        impl->wake.notify_all();
+        return result;
+    }
+
+    auto eval_scheduler::size() const -> std::size_t { return impl->workers; }
+
+    auto eval_scheduler::requester_count() const -> std::size_t
+    {
+        std::lock_guard lock(impl->mutex);
+        return impl->requesters.size();
+    }
+} // namespace mtce
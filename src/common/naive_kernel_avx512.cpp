@@ -0,0 +1,29 @@
+// the naive evaluator built for avx-512f and avx-512bw, only called once cpuid says the cpu supports it
+
+#include "common/naive_kernel.h"
+
+#ifdef MTCE_X86_KERNELS
+#include <immintrin.h>
+
+// everything below is compiled for the target, the headers above keep the baseline target
+#ifdef __clang__
+#pragma clang attribute push(__attribute__((target("avx512f,avx512bw"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
+#endif
+
+#define MTCE_KERNEL_ISA MTCE_ISA_AVX512
+#define MTCE_KERNEL_NAME "avx512"
+
+namespace mtce::kernel::avx512
+{
+#include "naive_kernel.inc"
+} // namespace mtce::kernel::avx512
+
+#ifdef __clang__
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
@@ -0,0 +1,11 @@
+// the naive evaluator built for the baseline target, used when nothing better is available (and everywhere but x86-64)
+
+#include "common/naive_kernel.h"
+
+#define MTCE_KERNEL_ISA MTCE_ISA_GENERIC
+#define MTCE_KERNEL_NAME "generic"
+
+namespace mtce::kernel::generic
+{
+#include "naive_kernel.inc"
+} // namespace mtce::kernel::generic
@@ -0,0 +1,29 @@
+// the naive evaluator built for sse4.2, only called once cpuid says the cpu supports it
+
+#include "common/naive_kernel.h"
+
+#ifdef MTCE_X86_KERNELS
+#include <immintrin.h>
+
+// everything below is compiled for the target, the headers above keep the baseline target
+#ifdef __clang__
+#pragma clang attribute push(__attribute__((target("sse4.2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+#endif
+
+#define MTCE_KERNEL_ISA MTCE_ISA_SSE42
+#define MTCE_KERNEL_NAME "sse4.2"
+
+namespace mtce::kernel::sse42
+{
+#include "naive_kernel.inc"
+} // namespace mtce::kernel::sse42
+
+#ifdef __clang__
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
@@ -0,0 +1,142 @@
+#include "common/thread_pool.h"
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace mtce::sched
+{
+    worker_pool::worker_pool(size_t threads)
+    {
+        std::lock_guard lock(mutex);
+        spawn(threads > 1 ? threads - 1 : 0);
+    }
+
+    worker_pool::~worker_pool() { resize(0); }
+
+    void worker_pool::worker_main()
+    {
+        std::unique_lock lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [&] { return stopping || !open.empty(); });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            auto* current = open.front();
+            const auto index = current->next++;
+            unclaimed--;
+            idle--;
+            if (current->next == current->workers)
+            {
+                open.pop_front();
+            }
+
+            lock.unlock();
+            (*current->fn)(index);
+            lock.lock();
+
+            idle++;
+            // current lives on the stack of run, and is gone once it sees pending reach 0
+            if (--current->pending == 0)
+            {
+                done.notify_all();
+            }
+        }
+    }
+
+    // with mutex held
+    void worker_pool::spawn(size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            threads.emplace_back([this] { worker_main(); });
+        }
+
+        idle += count;
+    }
+
+    auto worker_pool::size() -> size_t
+    {
+        std::lock_guard lock(mutex);
+        return threads.size() + 1;
+    }
+
+    void worker_pool::resize(size_t workers)
+    {
+        std::vector<std::thread> stopped;
+        {
+            std::unique_lock lock(mutex);
+            done.wait(lock, [&] { return running == 0 && !resizing; });
+            resizing = true;
+            stopping = true;
+            stopped = std::move(threads);
+            threads.clear();
+        }
+
+        wake.notify_all();
+        for (auto& thread : stopped)
+        {
+            thread.join();
+        }
+
+        std::lock_guard lock(mutex);
+        stopping = false;
+        resizing = false;
+        idle = 0;
+        spawn(workers > 1 ? workers - 1 : 0);
+        done.notify_all();
+    }
+
+    void worker_pool::run(size_t workers, const std::function<void(size_t)>& fn)
+    {
+        if (workers == 0)
+        {
+            return;
+        }
+
+        // the calling thread is all a batch of one needs
+        if (workers == 1)
+        {
+            fn(0);
+            return;
+        }
+
+        batch current{.fn = &fn, .workers = workers, .pending = workers - 1};
+        {
+            std::unique_lock lock(mutex);
+            done.wait(lock, [&] { return !resizing; });
+
+            // every index handed out so far needs a thread of its own, or a batch could wait on one that never comes - the threads that
+            // started the batches are busy running them
+            unclaimed += workers - 1;
+            if (idle < unclaimed)
+            {
+                spawn(unclaimed - idle);
+            }
+
+            open.push_back(&current);
+            running++;
+        }
+
+        wake.notify_all();
+        fn(0);
+
+        std::unique_lock lock(mutex);
+        done.wait(lock, [&] { return current.pending == 0; });
+        running--;
+        if (running == 0)
+        {
+            done.notify_all();
+        }
+    }
+
+    auto global_pool() -> worker_pool&
+    {
+        static worker_pool pool;
+        return pool;
+    }
+} // namespace mtce::sched
@@ -0,0 +1,197 @@
+#include "common/topology.h"
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace mtce::sched
+{
+    namespace
+    {
+        auto read_sysfs_id(const std::filesystem::path& path, unsigned fallback) -> unsigned
+        {
+            std::ifstream ifs(path);
+            int value = -1;
+            // some platforms report -1 for ids they don't know
+            return ifs >> value && value >= 0 ? (unsigned)value : fallback;
+        }
+
+        auto node_of(const std::filesystem::path& cpu_dir) -> unsigned
+        {
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(cpu_dir, ec))
+            {
+                auto name = entry.path().filename().string();
+                if (name.starts_with("node") && name.size() > 4 && std::ranges::all_of(name.substr(4), [](char c) { return c >= '0' && c <= '9'; }))
+                {
+                    return std::stoul(name.substr(4));
+                }
+            }
+
+            return 0;
+        }
+
+        auto allowed_cpus() -> std::vector<unsigned>
+        {
+            std::vector<unsigned> cpus;
+
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            {
+                for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                {
+                    if (CPU_ISSET(cpu, &set))
+                    {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+
+            if (cpus.empty())
+            {
+                for (unsigned cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1U); cpu++)
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+
+            return cpus;
+        }
+
+        auto detect_topology() -> cpu_topology
+        {
+            static const std::filesystem::path SYSFS_CPU = "/sys/devices/system/cpu";
+
+            std::vector<cpu_info> cpus;
+
+            for (const auto cpu : allowed_cpus())
+            {
+                auto dir = SYSFS_CPU / ("cpu" + std::to_string(cpu));
+                cpus.push_back({
+                    .cpu = cpu,
+                    .core = read_sysfs_id(dir / "topology" / "core_id", cpu),
+                    .package = read_sysfs_id(dir / "topology" / "physical_package_id", 0),
+                    .node = node_of(dir),
+                });
+            }
+
+            return make_topology(std::move(cpus));
+        }
+    } // namespace
+
+    auto make_topology(std::vector<cpu_info> cpus) -> cpu_topology
+    {
+        // core ids are only unique within a package
+        std::map<std::pair<unsigned, unsigned>, unsigned> core_ids;
+        for (auto& cpu : cpus)
+        {
+            cpu.core = core_ids.try_emplace({cpu.package, cpu.core}, core_ids.size()).first->second;
+        }
+
+        std::ranges::stable_sort(cpus, [](const cpu_info& lhs, const cpu_info& rhs) {
+            return std::pair(lhs.node, lhs.core) < std::pair(rhs.node, rhs.core);
+        });
+
+        // the n-th logical cpu of every core forms round n of the placement
+        std::vector<size_t> rank(cpus.size());
+        std::map<unsigned, size_t> seen;
+        std::map<unsigned, unsigned> nodes;
+        for (size_t i = 0; i < cpus.size(); i++)
+        {
+            rank[i] = seen[cpus[i].core]++;
+            cpus[i].smt_sibling = rank[i] > 0;
+            nodes[cpus[i].node]++;
+        }
+
+        std::vector<size_t> order(cpus.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        std::ranges::stable_sort(order, [&](size_t lhs, size_t rhs) { return rank[lhs] < rank[rhs]; });
+
+        cpu_topology topology{
+            .cores = core_ids.size(),
+            .nodes = nodes.size(),
+        };
+
+        topology.cpus.reserve(cpus.size());
+        for (const auto index : order)
+        {
+            topology.cpus.push_back(cpus[index]);
+        }
+
+        return topology;
+    }
+
+    auto system_topology() -> const cpu_topology&
+    {
+        static const auto topology = detect_topology();
+        return topology;
+    }
+
+    auto place_workers(const cpu_topology& topology, std::size_t workers) -> std::vector<cpu_info>
+    {
+        std::vector<cpu_info> placement;
+        if (topology.cpus.empty())
+        {
+            return placement;
+        }
+
+        placement.reserve(workers);
+        for (size_t i = 0; i < workers; i++)
+        {
+            placement.push_back(topology.cpus[i % topology.cpus.size()]);
+        }
+
+        return placement;
+    }
+
+#ifdef __linux__
+    scoped_affinity::scoped_affinity(unsigned cpu)
+    {
+        cpu_set_t current;
+        if (cpu >= CPU_SETSIZE || pthread_getaffinity_np(pthread_self(), sizeof(current), &current) != 0)
+        {
+            return;
+        }
+
+        cpu_set_t target;
+        CPU_ZERO(&target);
+        CPU_SET(cpu, &target);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(target), &target) == 0)
+        {
+            previous = current;
+        }
+    }
+
+    scoped_affinity::~scoped_affinity()
+    {
+        if (previous)
+        {
+            pthread_setaffinity_np(pthread_self(), sizeof(*previous), &*previous);
+        }
+    }
+
+    auto scoped_affinity::pinned() const -> bool { return previous.has_value(); }
+#else
+    scoped_affinity::scoped_affinity(unsigned /*cpu*/) {}
+
+    scoped_affinity::~scoped_affinity() = default;
+
+    auto scoped_affinity::pinned() const -> bool { return false; }
+#endif
+} // namespace mtce::sched
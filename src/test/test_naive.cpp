@@ -1,13 +1,65 @@
+#include "common/aligned_eval.h"
 #include "common/eval.h"
+#include "common/eval_scheduler.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
 #include <cstdint>
+#include <future>
+#include <limits>
+#include <optional>
+#include <string>
 #include <vector>
 
 using namespace mtce;
+using namespace mtce::vec;
 using namespace testing;
 
 // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+namespace
+{
+    // with max_cp 5, {0, 2} caps both abilities, and so do {0, 1, 2}, {0, 2, 3} and {0, 1, 2, 3} - 1 only adds to ability 0, which 0 alone
+    // caps, so the saturation skip never looks at a set with both, although those would win the tie-break
+    // the filler gives parallel runs jobs to split, and best-first search's dive runs into {0, 1, 2, 3} unless it skips 1 too
+    auto saturated_ties() -> std::vector<charm>
+    {
+        std::vector<charm> charms(4);
+        charms[0] = {.charm_power = 1};
+        charms[0].set_effect(0, EFFECT_CAPS.at(0));
+        charms[1] = {.charm_power = 1};
+        charms[1].set_effect(0, 0.5 * EFFECT_CAPS.at(0));
+        charms[2] = {.charm_power = 2};
+        charms[2].set_effect(1, EFFECT_CAPS.at(1));
+        charms[3] = {.charm_power = 1};
+        charms[3].set_effect(1, 0.5 * EFFECT_CAPS.at(1));
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            charms.push_back({.charm_power = 3});
+            charms.back().set_effect(1, 0.25 * EFFECT_CAPS.at(1));
+        }
+
+        return charms;
+    }
+
+    // a deterministic mix of gains and losses over six abilities, for the tests that compare ways of running the same search
+    auto synthetic_inventory(uint32_t count) -> std::vector<charm>
+    {
+        std::vector<charm> charms;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            charm instance{.charm_power = 1 + i % 4};
+            instance.set_effect(i % 3, -(double)((i * 7) % 11));
+            instance.add_effect(1 + i % 5, (double)((i * 5) % 3));
+            charms.push_back(instance);
+        }
+
+        return charms;
+    }
+} // namespace
+
 TEST(naive, empty)
 {
 
@@ -23,12 +75,42 @@ TEST(naive, empty)
     }
 }
 
+TEST(naive, sparse_effects)
+{
+    charm instance{.charm_power = 1};
+    instance.set_effect(7, 2);
+    instance.set_effect(3, -1);
+    instance.add_effect(7, 1);
+    instance.set_effect(5, 4);
+    instance.set_effect(5, 0);
+
+    ASSERT_THAT(instance.effects, ElementsAre(charm_effect{.ability = 3, .value = -1}, charm_effect{.ability = 7, .value = 3}));
+    ASSERT_EQ(instance.effect(7), 3);
+    ASSERT_EQ(instance.effect(5), 0);
+    ASSERT_EQ(instance.dense_effects().at(3), -1);
+}
+
+TEST(naive, effect_name_lookup)
+{
+    static_assert(find_effect(EFFECT_NAMES[0]) == 0);
+
+    for (size_t i = 0; i < ABILITY_COUNT; i++)
+    {
+        ASSERT_EQ(find_effect(EFFECT_NAMES[i]), i);
+        ASSERT_EQ(find_effect(std::string(EFFECT_NAMES[i]) + "_"), std::nullopt);
+        ASSERT_EQ(find_effect(EFFECT_NAMES[i].substr(1)), std::nullopt);
+    }
+
+    ASSERT_EQ(find_effect(""), std::nullopt);
+    ASSERT_EQ(find_effect("not_an_effect"), std::nullopt);
+}
+
 TEST(naive, single)
 {
     auto [utility, charm_set] = evaluate_naive({
         .charms =
             {
-                {.charm_power = 1, .charm_data = {-30}},
+                {.charm_power = 1, .effects = {{0, -30}}},
             },
         .max_cp = 15,
         .weights = {1},
@@ -42,8 +124,8 @@ TEST(naive, choice)
     auto [utility, charm_set] = evaluate_naive({
         .charms =
             {
-                {.charm_power = 1, .charm_data = {-29}},
-                {.charm_power = 1, .charm_data = {-30}},
+                {.charm_power = 1, .effects = {{0, -29}}},
+                {.charm_power = 1, .effects = {{0, -30}}},
             },
         .max_cp = 1,
         .weights = {1},
@@ -57,14 +139,14 @@ TEST(naive, choice_many)
     auto [utility, charm_set] = evaluate_naive({
         .charms =
             {
-                {.charm_power = 1, .charm_data = {-1}}, {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-1}},
-                {.charm_power = 1, .charm_data = {-1}}, {.charm_power = 1, .charm_data = {-1}}, {.charm_power = 1, .charm_data = {-1}},
-                {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-2}},
-                {.charm_power = 1, .charm_data = {-1}}, {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-2}},
-                {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-1}}, {.charm_power = 1, .charm_data = {-2}},
-                {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-2}},
-                {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-2}},
-                {.charm_power = 1, .charm_data = {-2}}, {.charm_power = 1, .charm_data = {-2}},
+                {.charm_power = 1, .effects = {{0, -1}}}, {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -1}}},
+                {.charm_power = 1, .effects = {{0, -1}}}, {.charm_power = 1, .effects = {{0, -1}}}, {.charm_power = 1, .effects = {{0, -1}}},
+                {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -2}}},
+                {.charm_power = 1, .effects = {{0, -1}}}, {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -2}}},
+                {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -1}}}, {.charm_power = 1, .effects = {{0, -2}}},
+                {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -2}}},
+                {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -2}}},
+                {.charm_power = 1, .effects = {{0, -2}}}, {.charm_power = 1, .effects = {{0, -2}}},
             },
         .max_cp = 15,
         .weights = {1},
@@ -73,4 +155,743 @@ TEST(naive, choice_many)
     ASSERT_THAT(charm_set, ElementsAre(1, 6, 7, 8, 10, 11, 12));
 }
 
+TEST(naive, saturation)
+{
+    // ability 0 caps out after two charms, so the third one is useless
+    auto [utility, charm_set] = evaluate_naive({
+        .charms =
+            {
+                {.charm_power = 1, .effects = {{0, -20}}},
+                {.charm_power = 1, .effects = {{0, -20}}},
+                {.charm_power = 1, .effects = {{0, -20}}},
+                {.charm_power = 1, .effects = {{1, 5}}},
+                {.charm_power = 1, .effects = {{0, -10}, {1, -3}}},
+            },
+        .max_cp = 15,
+        .weights = {1, 1},
+    });
+
+    ASSERT_EQ(utility, ENCODED_CHARM_STAT_SCALE + ENCODED_CHARM_STAT_SCALE / 2);
+    ASSERT_THAT(charm_set, Contains(3));
+    ASSERT_THAT(charm_set, Not(Contains(4)));
+}
+
+TEST(naive, saturated_ties)
+{
+    // the split into jobs and the walks must skip the same redundant charms as the serial recursion, or they find a different tie
+    const auto charms = saturated_ties();
+    for (size_t threads : {1, 2, 4})
+    {
+        for (auto walk : {naive_walk::recursive, naive_walk::in_place, naive_walk::sparse, naive_walk::tiled})
+        {
+            for (bool prune_bound : {false, true})
+            {
+                auto result = evaluate_naive(
+                    {.charms = charms, .max_cp = 5, .weights = {1, 1}, .threads = threads, .prune_bound = prune_bound, .walk = walk}
+                );
+                ASSERT_EQ(result.utility_value, 2 * ENCODED_CHARM_STAT_SCALE);
+                ASSERT_THAT(result.charms, ElementsAre(0, 2)) << threads << " threads";
+            }
+        }
+    }
+}
+
+TEST(naive, cp_buckets)
+{
+    for (size_t threads : {1, 4})
+    {
+        // {1, 2, 3} would be better, but 1 and 2 are an upgrade pair - this checks that pairs survive sorting by cp
+        auto [utility, charm_set] = evaluate_naive({
+            .charms =
+                {
+                    {.charm_power = 4, .effects = {{0, -10}}},
+                    {.charm_power = 1, .has_upgrade = true, .effects = {{0, -5}}},
+                    {.charm_power = 1, .effects = {{0, -7}}},
+                    {.charm_power = 3, .effects = {{0, -9}}},
+                    {.charm_power = 2, .effects = {{0, -4}}},
+                },
+            .max_cp = 6,
+            .weights = {1},
+            .threads = threads,
+        });
+
+        ASSERT_THAT(charm_set, ElementsAre(2, 3, 4));
+
+        // an upgrade that costs more than its base can't share its bucket, the pair is split instead of leaving the table unsorted
+        auto [split_utility, split_set] = evaluate_naive({
+            .charms =
+                {
+                    {.charm_power = 1, .has_upgrade = true, .effects = {{0, -5}}},
+                    {.charm_power = 9, .effects = {{0, -20}}},
+                    {.charm_power = 2, .effects = {{0, -4}}},
+                    {.charm_power = 2, .effects = {{0, -3}}},
+                },
+            .max_cp = 3,
+            .weights = {1},
+            .threads = threads,
+        });
+
+        ASSERT_THAT(split_set, ElementsAre(0, 2));
+    }
+}
+
+TEST(naive, estimate)
+{
+    // {}, 3 singles and 3 pairs
+    auto estimate = estimate_naive({
+        .charms =
+            {
+                {.charm_power = 1, .effects = {{0, -1}}},
+                {.charm_power = 1, .effects = {{0, -1}}},
+                {.charm_power = 1, .effects = {{0, -1}}},
+            },
+        .max_cp = 2,
+        .weights = {1},
+    });
+
+    ASSERT_EQ(estimate.nodes, 7);
+    ASSERT_EQ(estimate.charms, 3);
+    ASSERT_EQ(estimate.abilities, 1);
+
+    // an upgrade pair can't be taken together: {}, A, A (u), B, AB, A (u)B
+    estimate = estimate_naive({
+        .charms =
+            {
+                {.charm_power = 1, .has_upgrade = true, .effects = {{0, -1}}},
+                {.charm_power = 1, .effects = {{0, -2}}},
+                {.charm_power = 1, .effects = {{0, -1}}},
+            },
+        .max_cp = 15,
+        .weights = {1},
+    });
+
+    ASSERT_EQ(estimate.nodes, 6);
+}
+
+TEST(naive, oversized_max_cp)
+{
+    // past the total cp of the inventory, a budget changes nothing - it must not size the estimator's tables either
+    eval_config config{
+        .charms =
+            {
+                {.charm_power = 1, .effects = {{0, -1}}},
+                {.charm_power = 2, .effects = {{0, -2}}},
+                {.charm_power = 3, .effects = {{0, -3}}},
+            },
+        .max_cp = 6,
+        .weights = {1},
+        .threads = 0,
+    };
+
+    const auto expected_estimate = estimate_naive(config);
+    const auto expected = evaluate_naive(config);
+
+    for (uint32_t max_cp : {1U << 30, std::numeric_limits<uint32_t>::max()})
+    {
+        config.max_cp = max_cp;
+        ASSERT_EQ(estimate_naive(config).nodes, expected_estimate.nodes);
+
+        auto result = evaluate_naive(config);
+        ASSERT_EQ(result.utility_value, expected.utility_value);
+        ASSERT_EQ(result.charms, expected.charms);
+    }
+}
+
+TEST(naive, profile_selection)
+{
+    eval_config config{
+        .charms =
+            {
+                {.charm_power = 1, .effects = {{0, -1}}},
+                {.charm_power = 1, .effects = {{0, -1}}},
+                {.charm_power = 1, .effects = {{0, -1}}},
+            },
+        .max_cp = 15,
+        .weights = {1},
+        .threads = 0,
+        .profile =
+            {
+                .entries =
+                    {
+                        {.threads = 1, .node_ns = 2, .lane_ns = 0, .thread_spawn_ns = 0},
+                        {.threads = 8, .node_ns = 2, .lane_ns = 0, .thread_spawn_ns = 1e6},
+                    },
+            },
+    };
+
+    // spawning dominates a tiny inventory
+    ASSERT_EQ(estimate_naive(config).threads, 1);
+
+    // but not a huge one
+    config.profile.entries[1].thread_spawn_ns = 0;
+    ASSERT_EQ(estimate_naive(config).threads, 8);
+
+    // an explicit thread count is never overridden
+    config.threads = 4;
+    ASSERT_EQ(estimate_naive(config).threads, 4);
+
+    // the kernel measured fastest is picked, at any thread count, and kernels this cpu can't run are skipped
+    const auto kernels = naive_kernels();
+    config.profile.entries = {
+        {.threads = 1, .node_ns = 2, .lane_ns = 0, .thread_spawn_ns = 0, .kernel = std::string(kernels.front())},
+        {.threads = 1, .node_ns = 1, .lane_ns = 0, .thread_spawn_ns = 0, .kernel = std::string(kernels.back())},
+        {.threads = 1, .node_ns = 0, .lane_ns = 0, .thread_spawn_ns = 0, .kernel = "no such kernel"},
+    };
+
+    auto unprofiled = config;
+    unprofiled.threads = 1;
+    unprofiled.profile = {};
+    const auto expected = evaluate_naive(unprofiled);
+
+    for (size_t threads : {0, 4})
+    {
+        config.threads = threads;
+        auto estimate = estimate_naive(config);
+        ASSERT_EQ(estimate.kernel, kernels.back());
+        ASSERT_EQ(estimate.threads, threads == 0 ? 1 : threads);
+
+        auto result = evaluate_naive(config);
+        ASSERT_EQ(result.utility_value, expected.utility_value);
+        ASSERT_EQ(result.charms, expected.charms);
+    }
+}
+
+TEST(naive, parallel_matches_serial)
+{
+    // enough charms for the work stealing scheduler to have something to steal
+    const auto charms = synthetic_inventory(40);
+
+    auto serial = evaluate_naive({.charms = charms, .max_cp = 15, .weights = {3, 2, 1, 1, 1, 1}, .threads = 1});
+
+    for (size_t threads : {2, 3, 8})
+    {
+        auto parallel = evaluate_naive({.charms = charms, .max_cp = 15, .weights = {3, 2, 1, 1, 1, 1}, .threads = threads});
+        ASSERT_EQ(parallel.utility_value, serial.utility_value);
+        ASSERT_EQ(parallel.charms, serial.charms);
+    }
+
+    // ties that saturation decides, with and without the coarse pass over the jobs
+    const auto ties = saturated_ties();
+    auto serial_ties = evaluate_naive({.charms = ties, .max_cp = 5, .weights = {1, 1}, .threads = 1});
+    for (size_t threads : {2, 3, 8})
+    {
+        for (bool coarse : {false, true})
+        {
+            auto parallel = evaluate_naive({.charms = ties, .max_cp = 5, .weights = {1, 1}, .threads = threads, .coarse = coarse});
+            ASSERT_EQ(parallel.utility_value, serial_ties.utility_value);
+            ASSERT_EQ(parallel.charms, serial_ties.charms) << threads << " threads";
+        }
+    }
+
+    // pinned workers (and their node-local tables) must not change the result
+    for (auto pin : {sched::pin_mode::cores, sched::pin_mode::numa})
+    {
+        size_t traced_workers = 0;
+        auto pinned = evaluate_naive(
+            {.charms = charms, .max_cp = 15, .weights = {3, 2, 1, 1, 1, 1}, .threads = 3, .pin = pin},
+            {.trace_placement = [&](const auto&, auto workers, auto) { traced_workers = workers.size(); }}
+        );
+        ASSERT_EQ(pinned.utility_value, serial.utility_value);
+        ASSERT_EQ(traced_workers, 3);
+    }
+}
+
+TEST(naive, kernels_agree)
+{
+    // 20 abilities pad to 24 lanes: full avx-512 blocks, a half block, and more than one block for everything else
+    std::vector<charm> charms;
+    charm_weights weights{};
+    for (uint32_t i = 0; i < 30; i++)
+    {
+        charm instance{.charm_power = 1 + i % 4};
+        instance.set_effect(i % 20, -(double)((i * 7) % 11) - 1);
+        instance.add_effect((i * 3 + 5) % 20, (double)((i * 5) % 3));
+        charms.push_back(instance);
+    }
+
+    for (size_t i = 0; i < 20; i++)
+    {
+        weights.at(i) = (int32_t)(1 + i % 5);
+    }
+
+    const auto original = std::string(naive_kernel_name());
+    ASSERT_TRUE(set_naive_kernel("generic"));
+
+    std::vector<eval_result> expected;
+    for (bool prune_bound : {false, true})
+    {
+        expected.push_back(evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = 1, .prune_bound = prune_bound}));
+    }
+
+    for (auto name : naive_kernels())
+    {
+        ASSERT_TRUE(set_naive_kernel(name));
+        for (bool prune_bound : {false, true})
+        {
+            auto result = evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = 2, .prune_bound = prune_bound});
+            ASSERT_EQ(result.utility_value, expected[prune_bound].utility_value) << name;
+            ASSERT_EQ(result.charms, expected[prune_bound].charms) << name;
+        }
+    }
+
+    ASSERT_FALSE(set_naive_kernel("no-such-isa"));
+    ASSERT_TRUE(set_naive_kernel(original));
+}
+
+TEST(naive, wide_configs_match_exhaustive)
+{
+    // 100 abilities is past the widths that get an evaluator of their own, so this runs on a shared, wider one
+    std::vector<charm> charms;
+    charm_weights weights{};
+    for (uint32_t i = 0; i < 12; i++)
+    {
+        charm instance{.charm_power = 1 + i % 4};
+        for (uint32_t k = 0; k < 9; k++)
+        {
+            const auto lane = (i * 37 + k * 11) % 100;
+            instance.set_effect(lane, (k % 4 == 3 ? -0.1 : 0.15) * (1 + (i + k) % 3) * EFFECT_CAPS.at(lane));
+        }
+        charms.push_back(instance);
+    }
+
+    for (size_t i = 0; i < 100; i++)
+    {
+        weights.at(i) = (int32_t)(1 + i % 7);
+    }
+
+    // every set of at most 7 charms within 9 cp, scored the way the evaluator encodes stats
+    int64_t best = 0;
+    for (uint32_t mask = 1; mask < (1U << charms.size()); mask++)
+    {
+        uint32_t cp = 0;
+        std::array<int64_t, 100> stats{};
+        for (size_t c = 0; c < charms.size(); c++)
+        {
+            if ((mask >> c & 1) != 0)
+            {
+                cp += charms[c].charm_power;
+                for (size_t lane = 0; lane < 100; lane++)
+                {
+                    stats.at(lane) += (int32_t)(charms[c].effect(lane) / EFFECT_CAPS.at(lane) * ENCODED_CHARM_STAT_SCALE);
+                }
+            }
+        }
+
+        if (cp > 9 || std::popcount(mask) > 7)
+        {
+            continue;
+        }
+
+        int64_t utility = 0;
+        for (size_t lane = 0; lane < 100; lane++)
+        {
+            utility += std::min<int64_t>(stats.at(lane), ENCODED_CHARM_STAT_SCALE) * weights.at(lane);
+        }
+        best = std::max(best, utility);
+    }
+
+    for (size_t threads : {1, 2})
+    {
+        auto result = evaluate_naive({.charms = charms, .max_cp = 9, .weights = weights, .threads = threads});
+        ASSERT_EQ(result.utility_value, best);
+    }
+}
+
+TEST(naive, leaf_blocks_agree)
+{
+    // 37 charms: full leaf blocks, leftovers, and blocks of equal candidates where ties must go to the first one
+    std::vector<charm> charms;
+    for (uint32_t i = 0; i < 37; i++)
+    {
+        charm instance{.charm_power = 1 + i % 3};
+        instance.set_effect(i % 5, -(double)(1 + i % 4));
+        instance.set_effect(5, 1);
+        charms.push_back(instance);
+    }
+
+    const auto original = std::string(naive_kernel_name());
+    ASSERT_TRUE(set_naive_kernel("generic"));
+
+    auto expected = evaluate_naive({.charms = charms, .max_cp = 9, .weights = {4, 3, 2, 1, 1, 1}, .threads = 1});
+    auto expected_narrow = evaluate_naive({.charms = charms, .max_cp = 9, .weights = {4, 3, 2, 1, 1, 1}, .threads = 1, .narrow_stats = true});
+
+    for (auto name : naive_kernels())
+    {
+        ASSERT_TRUE(set_naive_kernel(name));
+        auto result = evaluate_naive({.charms = charms, .max_cp = 9, .weights = {4, 3, 2, 1, 1, 1}, .threads = 1});
+        ASSERT_EQ(result.utility_value, expected.utility_value) << name;
+        ASSERT_EQ(result.charms, expected.charms) << name;
+
+        auto narrow = evaluate_naive({.charms = charms, .max_cp = 9, .weights = {4, 3, 2, 1, 1, 1}, .threads = 1, .narrow_stats = true});
+        ASSERT_EQ(narrow.utility_value, expected_narrow.utility_value) << name;
+        ASSERT_EQ(narrow.charms, expected_narrow.charms) << name;
+    }
+
+    ASSERT_TRUE(set_naive_kernel(original));
+}
+
+TEST(naive, in_place_walks_match_recursive)
+{
+    // the same as kernels_agree, with a few gains on the first lanes so that some of them saturate
+    std::vector<charm> charms;
+    charm_weights weights{};
+    for (uint32_t i = 0; i < 30; i++)
+    {
+        charm instance{.charm_power = 1 + i % 4};
+        instance.set_effect(i % 20, -(double)((i * 7) % 11) - 1);
+        instance.add_effect((i * 3 + 5) % 20, (double)((i * 5) % 3));
+        instance.set_effect(20 + i % 2, 0.4 * EFFECT_CAPS.at(20 + i % 2));
+        charms.push_back(instance);
+    }
+
+    for (size_t i = 0; i < 22; i++)
+    {
+        weights.at(i) = (int32_t)(1 + i % 5);
+    }
+
+    const auto original = std::string(naive_kernel_name());
+    for (auto name : naive_kernels())
+    {
+        ASSERT_TRUE(set_naive_kernel(name));
+        for (size_t threads : {1, 3})
+        {
+            for (bool prune_bound : {false, true})
+            {
+                auto recursive = evaluate_naive(
+                    {.charms = charms, .max_cp = 12, .weights = weights, .threads = threads, .prune_bound = prune_bound, .walk = naive_walk::recursive}
+                );
+                for (auto walk : {naive_walk::in_place, naive_walk::sparse, naive_walk::tiled})
+                {
+                    auto result = evaluate_naive(
+                        {.charms = charms, .max_cp = 12, .weights = weights, .threads = threads, .prune_bound = prune_bound, .walk = walk}
+                    );
+                    ASSERT_EQ(result.utility_value, recursive.utility_value) << name << " walk " << (int)walk;
+                    ASSERT_EQ(result.charms, recursive.charms) << name << " walk " << (int)walk;
+                }
+            }
+        }
+    }
+
+    ASSERT_TRUE(set_naive_kernel(original));
+}
+
+TEST(naive, coarse_pass_matches_exact)
+{
+    // large gains and losses on the same lanes, so that the 8-bit stats saturate, and negative weights for the negated lanes
+    std::vector<charm> charms;
+    charm_weights weights{};
+    for (uint32_t i = 0; i < 28; i++)
+    {
+        charm instance{.charm_power = 1 + i % 4};
+        instance.set_effect(i % 12, (i % 3 == 0 ? -0.6 : 0.45) * EFFECT_CAPS.at(i % 12));
+        instance.add_effect((i * 5 + 3) % 12, 0.2 * EFFECT_CAPS.at((i * 5 + 3) % 12));
+        instance.set_effect(12 + i % 3, (double)((i * 7) % 5) - 2);
+        charms.push_back(instance);
+    }
+
+    for (size_t i = 0; i < 15; i++)
+    {
+        weights.at(i) = i % 4 == 1 ? -(int32_t)(1 + i % 3) : (int32_t)(1 + i % 5);
+    }
+
+    const auto original = std::string(naive_kernel_name());
+    for (auto name : naive_kernels())
+    {
+        ASSERT_TRUE(set_naive_kernel(name));
+        for (size_t threads : {1, 3})
+        {
+            auto exact = evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = threads});
+            auto coarse = evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = threads, .coarse = true});
+            ASSERT_EQ(coarse.utility_value, exact.utility_value) << name;
+            ASSERT_EQ(coarse.charms, exact.charms) << name;
+        }
+    }
+
+    ASSERT_TRUE(set_naive_kernel(original));
+}
+
+TEST(naive, best_first_matches_depth_first)
+{
+    // one ability worth far more than the others, and a queue limit small enough to make it fall back
+    std::vector<charm> charms;
+    charm_weights weights{};
+    for (uint32_t i = 0; i < 30; i++)
+    {
+        charm instance{.charm_power = 1 + i % 4};
+        instance.set_effect(i % 10, (double)((i * 7) % 5) - 1);
+        instance.set_effect((i * 3 + 1) % 10, (i % 4 == 0 ? -0.3 : 0.35) * EFFECT_CAPS.at((i * 3 + 1) % 10));
+        charms.push_back(instance);
+    }
+
+    for (size_t i = 0; i < 10; i++)
+    {
+        weights.at(i) = i == 4 ? 50 : (int32_t)(1 + i % 3);
+    }
+
+    const auto original = std::string(naive_kernel_name());
+    for (auto name : naive_kernels())
+    {
+        ASSERT_TRUE(set_naive_kernel(name));
+        auto depth_first = evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = 1});
+        for (size_t limit : {BEST_FIRST_LIMIT, size_t{16}})
+        {
+            auto best_first =
+                evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = 1, .best_first = true, .best_first_limit = limit});
+            ASSERT_EQ(best_first.utility_value, depth_first.utility_value) << name << " limit " << limit;
+            ASSERT_EQ(best_first.charms, depth_first.charms) << name << " limit " << limit;
+        }
+
+        // ties that saturation decides, which the dive that seeds the search runs into
+        const auto ties = saturated_ties();
+        auto depth_first_ties = evaluate_naive({.charms = ties, .max_cp = 5, .weights = {1, 1}, .threads = 1});
+        for (size_t limit : {BEST_FIRST_LIMIT, size_t{4}})
+        {
+            auto best_first =
+                evaluate_naive({.charms = ties, .max_cp = 5, .weights = {1, 1}, .threads = 1, .best_first = true, .best_first_limit = limit});
+            ASSERT_EQ(best_first.utility_value, depth_first_ties.utility_value) << name << " limit " << limit;
+            ASSERT_EQ(best_first.charms, depth_first_ties.charms) << name << " limit " << limit;
+        }
+    }
+
+    ASSERT_TRUE(set_naive_kernel(original));
+}
+
+TEST(naive, portfolio_matches_depth_first)
+{
+    // one ability worth far more than the others on a narrow config, and more than enough abilities on a wide one for the coarse engine
+    for (size_t abilities : {10, 100})
+    {
+        std::vector<charm> charms;
+        charm_weights weights{};
+        for (uint32_t i = 0; i < 30; i++)
+        {
+            charm instance{.charm_power = 1 + i % 4};
+            instance.set_effect(i % abilities, (double)((i * 7) % 5) - 1);
+            instance.set_effect((i * 3 + 1) % abilities, (i % 4 == 0 ? -0.3 : 0.35) * EFFECT_CAPS.at((i * 3 + 1) % abilities));
+            instance.add_effect((i * 37 + 5) % abilities, 0.2 * EFFECT_CAPS.at((i * 37 + 5) % abilities));
+            charms.push_back(instance);
+        }
+
+        for (size_t i = 0; i < abilities; i++)
+        {
+            weights.at(i) = i == 4 ? 50 : (int32_t)(1 + i % 3);
+        }
+
+        const auto original = std::string(naive_kernel_name());
+        for (auto name : naive_kernels())
+        {
+            ASSERT_TRUE(set_naive_kernel(name));
+            auto depth_first = evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = 1});
+            for (size_t threads : {1, 2, 4})
+            {
+                auto portfolio = evaluate_portfolio({.charms = charms, .max_cp = 12, .weights = weights, .threads = threads});
+                ASSERT_EQ(portfolio.utility_value, depth_first.utility_value) << name << " " << threads << " threads";
+                ASSERT_EQ(portfolio.charms, depth_first.charms) << name << " " << threads << " threads";
+            }
+        }
+
+        ASSERT_TRUE(set_naive_kernel(original));
+    }
+
+    // ties that saturation decides - whichever engine wins has to report the same one
+    const auto ties = saturated_ties();
+    auto depth_first = evaluate_naive({.charms = ties, .max_cp = 5, .weights = {1, 1}, .threads = 1});
+    for (size_t threads : {1, 2, 3, 4})
+    {
+        for (size_t run = 0; run < 10; run++)
+        {
+            auto portfolio = evaluate_portfolio({.charms = ties, .max_cp = 5, .weights = {1, 1}, .threads = threads});
+            ASSERT_EQ(portfolio.utility_value, depth_first.utility_value) << threads << " threads";
+            ASSERT_EQ(portfolio.charms, depth_first.charms) << threads << " threads";
+        }
+    }
+}
+
+TEST(naive, narrow_stats_within_bound)
+{
+    // every lane only gains or only loses, and losses stay small enough for seven charms to fit in 16 bits
+    // 40 abilities pad to 48 narrow lanes: one full avx-512 block and a half one
+    std::vector<charm> charms;
+    charm_weights weights{};
+    for (uint32_t i = 0; i < 40; i++)
+    {
+        charm instance{.charm_power = 1 + i % 4};
+        for (uint32_t lane : {i % 40, (i * 7 + 3) % 40, (i * 13 + 5) % 40})
+        {
+            const auto rel = lane % 3 == 2 ? -0.02 * (1 + (i * 3) % 7) : 0.05 * (1 + (i * 5) % 8);
+            instance.set_effect(lane, rel * EFFECT_CAPS.at(lane));
+        }
+        charms.push_back(instance);
+    }
+
+    for (size_t i = 0; i < 40; i++)
+    {
+        weights.at(i) = i % 5 == 4 ? -(int32_t)(1 + i % 3) : (int32_t)(1 + i % 4);
+    }
+
+    auto wide = evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = 1});
+
+    bool used_narrow = false;
+    int64_t max_gap = -1;
+    naive_tracing_config trace{.trace_encoding = [&](bool used, int64_t gap) {
+        used_narrow = used;
+        max_gap = gap;
+    }};
+
+    auto narrow = evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = 1, .narrow_stats = true}, trace);
+
+    ASSERT_TRUE(used_narrow);
+    ASSERT_LE(narrow.utility_value, wide.utility_value);
+    ASSERT_GE(narrow.utility_value, wide.utility_value - max_gap);
+
+    // the saturating kernels, the bound, and the parallel and scheduled paths must all pick the same set
+    const auto original = std::string(naive_kernel_name());
+    for (auto name : naive_kernels())
+    {
+        ASSERT_TRUE(set_naive_kernel(name));
+        for (size_t threads : {1, 4})
+        {
+            for (bool prune_bound : {false, true})
+            {
+                auto result = evaluate_naive(
+                    {.charms = charms, .max_cp = 12, .weights = weights, .threads = threads, .prune_bound = prune_bound, .narrow_stats = true}
+                );
+                ASSERT_EQ(result.utility_value, narrow.utility_value) << name;
+                ASSERT_EQ(result.charms, narrow.charms) << name;
+            }
+        }
+    }
+    ASSERT_TRUE(set_naive_kernel(original));
+
+    eval_scheduler scheduler(2);
+    auto scheduled = scheduler.submit(1, {.charms = charms, .max_cp = 12, .weights = weights, .threads = 1, .narrow_stats = true}).get();
+    ASSERT_EQ(scheduled.utility_value, narrow.utility_value);
+    ASSERT_EQ(scheduled.charms, narrow.charms);
+
+    // a lane that gains and loses can't saturate early, so that falls back to 32 bits
+    charms[1].set_effect(0, -charms[0].effect(0));
+    wide = evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = 1});
+    narrow = evaluate_naive({.charms = charms, .max_cp = 12, .weights = weights, .threads = 1, .narrow_stats = true}, trace);
+
+    ASSERT_FALSE(used_narrow);
+    ASSERT_EQ(narrow.utility_value, wide.utility_value);
+    ASSERT_EQ(narrow.charms, wide.charms);
+}
+
+TEST(naive, bound_matches_exhaustive)
+{
+    std::vector<charm> charms;
+    for (uint32_t i = 0; i < 30; i++)
+    {
+        charm instance{.charm_power = 1 + i % 3};
+        instance.set_effect(i % 4, -(double)((i * 7) % 13));
+        instance.add_effect(2 + i % 3, (double)((i * 5) % 4) - 1);
+        charms.push_back(instance);
+    }
+
+    auto exhaustive = evaluate_naive({.charms = charms, .max_cp = 12, .weights = {100, 3, 2, 1, 1}, .threads = 1});
+
+    for (size_t threads : {1, 4})
+    {
+        auto bounded = evaluate_naive({.charms = charms, .max_cp = 12, .weights = {100, 3, 2, 1, 1}, .threads = threads, .prune_bound = true});
+        ASSERT_EQ(bounded.utility_value, exhaustive.utility_value);
+    }
+}
+
+TEST(naive, ties_pick_smallest_set)
+{
+    // {0} and {1, 2} are worth the same, the evaluator sees {1, 2} first since it works in cp order
+    std::vector<charm> charms(3);
+    charms[0] = {.charm_power = 2};
+    charms[0].set_effect(0, -2);
+    charms[1] = {.charm_power = 1};
+    charms[1].set_effect(0, -1);
+    charms[2] = charms[1];
+
+    // a lot of interchangeable charms
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        charms.push_back({.charm_power = 3});
+        charms.back().set_effect(1, 1);
+    }
+
+    for (size_t threads : {1, 2, 4})
+    {
+        for (bool prune_bound : {false, true})
+        {
+            auto cheap = evaluate_naive({.charms = charms, .max_cp = 2, .weights = {1, 1}, .threads = threads, .prune_bound = prune_bound});
+            ASSERT_THAT(cheap.charms, ElementsAre(0));
+
+            auto interchangeable = evaluate_naive({.charms = charms, .max_cp = 6, .weights = {0, 1}, .threads = threads, .prune_bound = prune_bound});
+            ASSERT_THAT(interchangeable.charms, ElementsAre(3, 4));
+        }
+    }
+}
+
+TEST(naive, shards_cover_search_space)
+{
+    const auto charms = synthetic_inventory(30);
+
+    auto full = evaluate_naive({.charms = charms, .max_cp = 15, .weights = {3, 2, 1, 1, 1, 1}, .threads = 1});
+
+    for (uint32_t count : {2, 3, 7})
+    {
+        int64_t best = 0;
+        for (uint32_t index = 0; index < count; index++)
+        {
+            auto shard = evaluate_naive(
+                {.charms = charms, .max_cp = 15, .weights = {3, 2, 1, 1, 1, 1}, .threads = 2, .shard = {.index = index, .count = count}}
+            );
+            ASSERT_LE(shard.utility_value, full.utility_value);
+            best = std::max(best, shard.utility_value);
+        }
+
+        ASSERT_EQ(best, full.utility_value);
+    }
+}
+
+TEST(naive, scheduler_matches_evaluate)
+{
+    eval_scheduler scheduler(3);
+    scheduler.set_share(2, 4);
+
+    std::vector<eval_config> configs;
+    for (uint32_t count : {0, 5, 20, 40})
+    {
+        configs.push_back({.charms = synthetic_inventory(count), .max_cp = 15, .weights = {3, 2, 1, 1, 1, 1}, .threads = 1});
+    }
+
+    std::vector<std::future<eval_result>> results;
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        results.push_back(scheduler.submit(i % 3, configs[i]));
+    }
+
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        auto expected = evaluate_naive(configs[i]);
+        auto actual = results[i].get();
+        ASSERT_EQ(actual.utility_value, expected.utility_value);
+        ASSERT_EQ(actual.charms, expected.charms);
+    }
+
+    // only the requester with a share of its own is remembered once everything is done
+    ASSERT_EQ(scheduler.requester_count(), 1);
+    scheduler.set_share(2, 1);
+    ASSERT_EQ(scheduler.requester_count(), 0);
+}
+
+TEST(naive, scheduler_interleaves_requesters)
+{
+    // a single worker, so the small request can only finish first if the large one gets interleaved with it
+    eval_scheduler scheduler(1);
+
+    auto large = scheduler.submit(1, {.charms = synthetic_inventory(50), .max_cp = 15, .weights = {3, 2, 1, 1, 1, 1}, .threads = 1});
+    auto small = scheduler.submit(2, {.charms = synthetic_inventory(10), .max_cp = 15, .weights = {3, 2, 1, 1, 1, 1}, .threads = 1});
+
+    small.wait();
+    ASSERT_EQ(large.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+    large.wait();
+}
+
 // NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
@@ -0,0 +1,135 @@
+#include "common/incumbent.h"
+#include "common/thread_pool.h"
+#include "common/topology.h"
+#include "common/work_stealing.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace mtce::sched;
+using namespace testing;
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+TEST(sched, pool_runs_every_worker)
+{
+    worker_pool pool(2);
+
+    for (size_t workers : {1, 2, 5, 3})
+    {
+        std::vector<std::atomic<int>> ran(workers);
+        pool.run(workers, [&](size_t worker) { ran[worker]++; });
+
+        for (const auto& count : ran)
+        {
+            ASSERT_EQ(count.load(), 1);
+        }
+    }
+
+    // grown on demand
+    ASSERT_EQ(pool.size(), 5);
+    pool.resize(2);
+    ASSERT_EQ(pool.size(), 2);
+}
+
+TEST(sched, pool_runs_nested_and_concurrent_batches)
+{
+    worker_pool pool(1);
+
+    // every worker of a batch starts a batch of its own, as the engines of a portfolio do
+    std::vector<std::atomic<int>> ran(3 * 4);
+    pool.run(3, [&](size_t outer) { pool.run(4, [&](size_t inner) { ran[(outer * 4) + inner]++; }); });
+
+    for (const auto& count : ran)
+    {
+        ASSERT_EQ(count.load(), 1);
+    }
+
+    // at most one thread per worker that isn't the caller of its batch, fewer when a batch finishes before another starts
+    ASSERT_LE(pool.size(), 2 + (3 * 3) + 1);
+
+    std::atomic<int> total = 0;
+    {
+        std::vector<std::thread> callers;
+        for (size_t i = 0; i < 4; i++)
+        {
+            callers.emplace_back([&] {
+                for (size_t run = 0; run < 50; run++)
+                {
+                    pool.run(3, [&](size_t) { total++; });
+                }
+            });
+        }
+
+        for (auto& caller : callers)
+        {
+            caller.join();
+        }
+    }
+
+    ASSERT_EQ(total.load(), 4 * 50 * 3);
+}
+
+TEST(sched, work_stealing_runs_every_job_once)
+{
+    constexpr size_t WORKERS = 4;
+    constexpr uint32_t JOBS = 1000;
+
+    // everything starts on one worker, the rest has to steal
+    std::vector<work_range> ranges(WORKERS);
+    ranges[0].assign(0, JOBS);
+
+    std::vector<std::atomic<int>> ran(JOBS);
+    worker_pool pool(WORKERS);
+    pool.run(WORKERS, [&](size_t worker) { run_work_stealing(ranges, worker, [&](uint32_t job) { ran[job]++; }); });
+
+    for (const auto& count : ran)
+    {
+        ASSERT_EQ(count.load(), 1);
+    }
+}
+
+TEST(sched, incumbent_only_improves)
+{
+    shared_incumbent incumbent;
+    ASSERT_TRUE(incumbent.offer(5));
+    ASSERT_FALSE(incumbent.offer(3));
+    ASSERT_FALSE(incumbent.offer(5));
+    ASSERT_TRUE(incumbent.offer(7));
+    ASSERT_EQ(incumbent.load(), 7);
+}
+
+TEST(sched, placement_prefers_physical_cores)
+{
+    // two sockets with two 2-way smt cores each, numbered the way linux interleaves them
+    std::vector<cpu_info> cpus;
+    for (unsigned cpu = 0; cpu < 8; cpu++)
+    {
+        cpus.push_back({.cpu = cpu, .core = (cpu / 2) % 2, .package = cpu % 2, .node = cpu % 2});
+    }
+
+    auto topology = make_topology(cpus);
+    ASSERT_EQ(topology.cores, 4);
+    ASSERT_EQ(topology.nodes, 2);
+
+    std::vector<unsigned> order;
+    std::vector<bool> siblings;
+    for (const auto& cpu : topology.cpus)
+    {
+        order.push_back(cpu.cpu);
+        siblings.push_back(cpu.smt_sibling);
+    }
+
+    ASSERT_THAT(order, ElementsAre(0, 2, 1, 3, 4, 6, 5, 7));
+    ASSERT_THAT(siblings, ElementsAre(false, false, false, false, true, true, true, true));
+
+    // more workers than cpus wrap around
+    auto placement = place_workers(topology, 10);
+    ASSERT_EQ(placement.size(), 10);
+    ASSERT_EQ(placement[8].cpu, 0);
+    ASSERT_EQ(placement[9].cpu, 2);
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)